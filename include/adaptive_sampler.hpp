@@ -0,0 +1,63 @@
+#ifndef WORMHOLE_ADAPTIVE_SAMPLER_HPP__
+#define WORMHOLE_ADAPTIVE_SAMPLER_HPP__
+
+#include <cstddef>
+#include <optional>
+
+#include "sky_map.hpp"
+#include "tracer.hpp"
+
+/* Lowers the sampling density away from the throat, where viewers look
+   and all the lensing is. Distances are angles from the center of the
+   throat as seen by the camera, in multiples of its apparent radius. */
+struct FoveationOptions {
+  /* Out to here the map is sampled as usual. */
+  double radius{1.5};
+  /* Beyond, the tolerance grows with the square of the distance over
+     RADIUS, up to this factor. */
+  double max_tolerance_scale{64.0};
+  /* Beyond, cells at most this many pixels across are interpolated from
+     their corners without probing, and past twice RADIUS cells twice as
+     large. Cells spanning both universes are still split. */
+  int min_cell{4};
+};
+
+struct AdaptiveOptions {
+  /* Spacing in pixels of the initial grid of traced rays. */
+  int coarse_step{16};
+  /* Largest error, as an angle on the sky in radians, that interpolating a
+     cell may make at its probe points before the cell is subdivided. */
+  double tolerance{5e-4};
+  std::optional<FoveationOptions> foveation{};
+};
+
+struct AdaptiveStats {
+  std::size_t traced{0};
+  std::size_t pixels{0};
+};
+
+/* Fills a SkyMap by tracing only where the camera-to-sky map is not smooth.
+
+   The image is covered by a grid of coarse cells whose corners are traced.
+   Each cell also traces its center and edge midpoints; if all of those land
+   in the same universe and bilinear interpolation of the corner directions
+   predicts them within the tolerance, the cell's pixels are interpolated.
+   Otherwise it is split into quadrants (whose corners are exactly the probes
+   just traced) and the test repeats, down to single pixels around the throat
+   silhouette and the Einstein ring.
+
+   With foveation, cells far from the throat tolerate larger errors and stop
+   being split sooner, so the periphery costs a fraction of the rays; the
+   map is still filled at every pixel by interpolation. */
+class AdaptiveSampler {
+public:
+  explicit AdaptiveSampler(AdaptiveOptions options = {}) : options_{options} {}
+
+  /* Fill MAP, which determines the image size, for CAMERA. */
+  auto sample(const Camera& camera, SkyMap& map) const -> AdaptiveStats;
+
+private:
+  AdaptiveOptions options_;
+};
+
+#endif /* WORMHOLE_ADAPTIVE_SAMPLER_HPP__ */
@@ -0,0 +1,111 @@
+#ifndef WORMHOLE_ANIMATED_TEXTURE_HPP__
+#define WORMHOLE_ANIMATED_TEXTURE_HPP__
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "decoded_image.hpp"
+#include "detail/globject.hpp"
+
+struct AnimatedTextureOptions {
+  double frames_per_second{24.0};
+  /* Decoded frames kept ahead of playback. Decoding may fall behind for
+     this many frames before playback has to hold or skip one. */
+  int prefetch_frames{8};
+  /* Start over after the last frame instead of holding it. */
+  bool loop{true};
+};
+
+/* A GL_TEXTURE_2D playing a numbered image sequence (sky_0000.png,
+   sky_0001.png, ...), for moving star fields and nebulae.
+
+   A worker thread decodes frames ahead of playback with
+   DecodedImage::decode, which writes no sidecars: a sequence has many
+   frames, each read once per loop, and caching them would fill the disk.
+   update picks the frame for the current time and copies
+   it into one of three pixel buffer objects, from which the texture is
+   updated on the GPU; fences keep a buffer from being overwritten while
+   still being read. Nothing in update waits: when the wanted frame hasn't
+   been decoded yet, or every buffer is busy, the texture keeps its current
+   frame until the next update, and frames that fell behind are skipped.
+
+   All members must be called on the thread owning the GL context, and the
+   context must still be current when the texture is destroyed. */
+class AnimatedTexture : private detail::GLObject {
+public:
+  /* Play the frames named by PATTERN, a printf pattern with one integer
+     such as "sky_%04d.png", counting up from 0 or 1 until a file is
+     missing. Decodes the first frame before returning; exits if there is
+     none. */
+  explicit AnimatedTexture(std::string pattern,
+                           AnimatedTextureOptions options = {});
+  ~AnimatedTexture();
+
+  AnimatedTexture(const AnimatedTexture&) = delete;
+  auto operator=(const AnimatedTexture&) -> AnimatedTexture& = delete;
+
+  /* Show the frame due at TIME seconds (glfwGetTime) if it is ready. Call
+     once per rendered frame. */
+  auto update(double time) -> void;
+
+  auto bind(int texture_unit) -> void;
+  inline auto texture_unit() const { return texture_unit_; }
+  inline auto frame_count() const { return frame_count_; }
+  /* Index of the frame on screen. */
+  inline auto frame() const { return static_cast<int>(shown_ % frame_count_); }
+  /* Frames skipped so far because they were decoded too late. */
+  inline auto dropped() const { return dropped_; }
+
+private:
+  static constexpr std::size_t buffer_count = 3;
+
+  struct Frame {
+    /* Position in playback; the file is TICK modulo the frame count. */
+    std::int64_t tick;
+    DecodedImage image;
+  };
+
+  auto frame_path(std::int64_t tick) const -> std::string;
+  auto decode_loop(std::stop_token stop) -> void;
+  /* Copy FRAME into a free pixel buffer and update the texture from it.
+     Returns false if every buffer is still being read. */
+  auto upload(const Frame& frame) -> bool;
+
+  std::string pattern_;
+  AnimatedTextureOptions options_;
+  int first_index_{0};
+  int frame_count_{0};
+  int width_{0};
+  int height_{0};
+  int nr_channels_{0};
+  GLenum format_{GL_RGB};
+  std::size_t frame_bytes_{0};
+  int texture_unit_{-1};
+
+  std::int64_t shown_{0};
+  std::int64_t dropped_{0};
+
+  GLuint buffers_{0};
+  unsigned char* buffer_memory_{nullptr};
+  std::array<GLsync, buffer_count> fences_{};
+  std::size_t next_buffer_{0};
+
+  std::mutex mutex_;
+  std::condition_variable_any space_cv_;
+  std::deque<Frame> ready_;
+  /* The tick playback wants, so the worker can skip past frames that would
+     only be dropped. Guarded by MUTEX_. */
+  std::int64_t wanted_{0};
+
+  /* Last, so the worker stops before the queue goes away. */
+  std::jthread worker_;
+};
+
+#endif /* WORMHOLE_ANIMATED_TEXTURE_HPP__ */
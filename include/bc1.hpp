@@ -0,0 +1,15 @@
+#ifndef WORMHOLE_BC1_HPP__
+#define WORMHOLE_BC1_HPP__
+
+#include <vector>
+
+#include "image.hpp"
+
+/* Compress IMAGE to BC1 (DXT1) blocks in row-major block order, for
+   GL_COMPRESSED_RGB_S3TC_DXT1_EXT. Each 4x4 block takes its endpoints from
+   the principal axis of its colors, refined once by least squares, and
+   always uses the four-color mode. Alpha is dropped; a one-channel image
+   becomes grey. Blocks are compressed in parallel. */
+auto encode_bc1(const Image& image) -> std::vector<unsigned char>;
+
+#endif /* WORMHOLE_BC1_HPP__ */
@@ -0,0 +1,65 @@
+#ifndef WORMHOLE_COLOR_HPP__
+#define WORMHOLE_COLOR_HPP__
+
+#include "srgb.hpp"
+
+/* Linear RGBA. */
+struct Color {
+  float r;
+  float g;
+  float b;
+  float a;
+};
+
+inline auto lerp(const Color& a, const Color& b, float t) -> Color {
+  return {a.r + t * (b.r - a.r), a.g + t * (b.g - a.g), a.b + t * (b.b - a.b),
+          a.a + t * (b.a - a.a)};
+}
+
+/* Decode an sRGB texel with CHANNELS channels, as laid out by stbi_load, to
+   linear. */
+inline auto decode_texel(const unsigned char* texel, int channels) -> Color {
+  switch (channels) {
+    case 1: {
+      const float grey = srgb_to_linear(texel[0]);
+      return {grey, grey, grey, 1.0f};
+    }
+    case 2: {
+      const float grey = srgb_to_linear(texel[0]);
+      return {grey, grey, grey, alpha_to_float(texel[1])};
+    }
+    case 3:
+      return {srgb_to_linear(texel[0]), srgb_to_linear(texel[1]),
+              srgb_to_linear(texel[2]), 1.0f};
+    default:
+      return {srgb_to_linear(texel[0]), srgb_to_linear(texel[1]),
+              srgb_to_linear(texel[2]), alpha_to_float(texel[3])};
+  }
+}
+
+/* Encode COLOR back into CHANNELS sRGB bytes at TEXEL. */
+inline auto encode_texel(const Color& color, int channels,
+                         unsigned char* texel) -> void {
+  switch (channels) {
+    case 1:
+      texel[0] = linear_to_srgb(color.r);
+      break;
+    case 2:
+      texel[0] = linear_to_srgb(color.r);
+      texel[1] = float_to_alpha(color.a);
+      break;
+    case 3:
+      texel[0] = linear_to_srgb(color.r);
+      texel[1] = linear_to_srgb(color.g);
+      texel[2] = linear_to_srgb(color.b);
+      break;
+    default:
+      texel[0] = linear_to_srgb(color.r);
+      texel[1] = linear_to_srgb(color.g);
+      texel[2] = linear_to_srgb(color.b);
+      texel[3] = float_to_alpha(color.a);
+      break;
+  }
+}
+
+#endif /* WORMHOLE_COLOR_HPP__ */
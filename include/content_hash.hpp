@@ -0,0 +1,13 @@
+#ifndef WORMHOLE_CONTENT_HASH_HPP__
+#define WORMHOLE_CONTENT_HASH_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+/* A fast non-cryptographic hash of SIZE bytes at DATA: four independent
+   multiply-rotate lanes over 32-byte blocks, so hashing keeps up with
+   reading a file. For telling whether cached data is still up to date. */
+auto content_hash(const unsigned char* data, std::size_t size)
+    -> std::uint64_t;
+
+#endif /* WORMHOLE_CONTENT_HASH_HPP__ */
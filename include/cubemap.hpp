@@ -0,0 +1,43 @@
+#ifndef WORMHOLE_CUBEMAP_HPP__
+#define WORMHOLE_CUBEMAP_HPP__
+
+#include <array>
+
+#include "equirect.hpp"
+#include "image.hpp"
+#include "sky_map.hpp"
+#include "vec3.hpp"
+
+/* Faces are numbered in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order (+X, -X,
+   +Y, -Y, +Z, -Z) and oriented as OpenGL samples them, so faces built here
+   can be uploaded as is and the CPU and GPU agree on every lookup. */
+inline constexpr int cube_faces = 6;
+
+/* Position on a face; s and t run over [0, 1] and row 0 of a face image is
+   at t = 0. */
+struct CubeUV {
+  int face;
+  double s;
+  double t;
+};
+
+/* The face DIRECTION points through and where. Needs no trigonometry, just
+   one division by the major axis. */
+auto cube_face_uv(Vec3 direction) -> CubeUV;
+
+/* Inverse of cube_face_uv, up to normalization. */
+auto cube_face_direction(int face, double s, double t) -> Vec3;
+
+/* FOOTPRINT of a pixel looking along DIRECTION, in FACE's (s, t). */
+auto cube_face_footprint(Vec3 direction, int face,
+                         const SkyFootprint& footprint) -> UVFootprint;
+
+/* Resample an equirectangular panorama (in stbi_load's layout) into six
+   FACE_SIZE x FACE_SIZE faces with the same channel count. Faces are
+   converted in parallel; each face texel averages 2x2 bilinear lookups in
+   linear space. */
+auto equirect_to_cubemap(const unsigned char* pixels, int width, int height,
+                         int channels, int face_size)
+    -> std::array<Image, cube_faces>;
+
+#endif /* WORMHOLE_CUBEMAP_HPP__ */
@@ -0,0 +1,79 @@
+#ifndef WORMHOLE_DECODED_IMAGE_HPP__
+#define WORMHOLE_DECODED_IMAGE_HPP__
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "image.hpp"
+#include "mapped_file.hpp"
+#include "mip_pyramid.hpp"
+
+/* One level of a DecodedImage, in the layout stbi_load produces. */
+struct ImageView {
+  int width;
+  int height;
+  int channels;
+  const unsigned char* data;
+};
+
+/* The decoded pixels of an image file, and optionally its mip chain.
+
+   Decoding a large JPEG or PNG sky takes seconds, so the first load writes
+   the raw pixels to a sidecar next to the source (FILE.decoded) and later
+   loads map that instead. The sidecar records the source's size,
+   modification time and a hash of its contents: if size and time match it
+   is used as is, otherwise the source is rehashed and the sidecar rebuilt
+   only if the contents really changed. A sidecar that can't be written
+   (read-only directory) just means decoding every time.
+
+   Next to it goes a thumbnail (FILE.proxy) no larger than proxy_size, for
+   showing something while the full image loads. */
+class DecodedImage {
+public:
+  static constexpr int proxy_size = 512;
+
+  /* Load FILE_PATH, exiting if it doesn't exist or can't be decoded. With
+     MIPS the levels include the mip chain built with that filter, taken
+     from the sidecar when it was built with the same filter. */
+  static auto load(std::string_view file_path,
+                   std::optional<MipFilter> mips = std::nullopt)
+      -> DecodedImage;
+  /* load, but returning nothing, with an error printed, instead of
+     exiting: for loads on worker threads, which must leave exiting to the
+     main thread. */
+  static auto try_load(std::string_view file_path,
+                       std::optional<MipFilter> mips = std::nullopt)
+      -> std::optional<DecodedImage>;
+
+  /* Decode FILE_PATH without looking for or writing a sidecar, for images
+     that are each read once per use, such as the frames of a sequence.
+     Exits if it can't be decoded. */
+  static auto decode(std::string_view file_path) -> DecodedImage;
+
+  /* The thumbnail a previous load wrote for FILE_PATH, if it is still up
+     to date. Never decodes the source. */
+  static auto load_proxy(std::string_view file_path)
+      -> std::optional<DecodedImage>;
+
+  /* Level 0 first; a single level unless mips were requested. */
+  inline auto levels() const -> const std::vector<ImageView>& {
+    return levels_;
+  }
+  inline auto base() const -> const ImageView& { return levels_.front(); }
+  /* Whether the pixels came from the sidecar rather than a decode. */
+  inline auto cached() const { return file_.has_value(); }
+
+  /* Copies of the levels, for owners that keep their own pixels. */
+  auto to_images() const -> std::vector<Image>;
+
+private:
+  DecodedImage() = default;
+
+  std::vector<ImageView> levels_;
+  /* Exactly one of these holds the pixels. */
+  std::optional<MappedFile> file_;
+  std::vector<Image> images_;
+};
+
+#endif /* WORMHOLE_DECODED_IMAGE_HPP__ */
@@ -0,0 +1,28 @@
+#ifndef WORMHOLE_DETAIL_SIMD_HPP__
+#define WORMHOLE_DETAIL_SIMD_HPP__
+
+#include <cstdint>
+#include <cstring>
+
+/* Portable fixed-width vectors (GCC/Clang vector extensions). They lower to
+   SSE/AVX on x86 and NEON on ARM without per-platform intrinsics. */
+namespace detail::simd {
+using f32x4 = float __attribute__((vector_size(16)));
+using f32x8 = float __attribute__((vector_size(32)));
+using i32x8 = std::int32_t __attribute__((vector_size(32)));
+using i64x8 = std::int64_t __attribute__((vector_size(64)));
+
+/* Unaligned loads and stores. Vectors are passed by reference so 32-byte
+   vectors don't change the calling convention when AVX is not enabled. */
+template <typename V, typename T>
+inline auto load(V& v, const T* p) -> void {
+  std::memcpy(&v, p, sizeof(V));
+}
+
+template <typename V, typename T>
+inline auto store(T* p, const V& v) -> void {
+  std::memcpy(p, &v, sizeof(V));
+}
+}  // namespace detail::simd
+
+#endif /* WORMHOLE_DETAIL_SIMD_HPP__ */
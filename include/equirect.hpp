@@ -0,0 +1,27 @@
+#ifndef WORMHOLE_EQUIRECT_HPP__
+#define WORMHOLE_EQUIRECT_HPP__
+
+#include "sky_map.hpp"
+#include "vec3.hpp"
+
+/* Texture-space position on an equirectangular sky. u wraps around at the
+   dateline (phi = +-pi); v runs from the north (0) to the south pole (1). */
+struct SkyUV {
+  double u;
+  double v;
+};
+
+/* A pixel's footprint in texture space, the image of SkyFootprint under the
+   equirectangular projection. */
+struct UVFootprint {
+  double du_dx;
+  double dv_dx;
+  double du_dy;
+  double dv_dy;
+};
+
+auto equirect_uv(Vec3 direction) -> SkyUV;
+auto equirect_footprint(Vec3 direction, const SkyFootprint& footprint)
+    -> UVFootprint;
+
+#endif /* WORMHOLE_EQUIRECT_HPP__ */
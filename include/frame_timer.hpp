@@ -0,0 +1,117 @@
+#ifndef WORMHOLE_FRAME_TIMER_HPP__
+#define WORMHOLE_FRAME_TIMER_HPP__
+
+#include <glad/gl.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+
+/* The parts of a viewer frame timed on the CPU, in order. */
+enum class FrameStage { Input, Compute, Upload, Draw, Swap };
+inline constexpr int frame_stage_count = 5;
+
+/* Durations counted in buckets on a log scale, so percentiles of any number
+   of frames take constant memory. Buckets are 1/16 of an octave wide
+   (about 4%) and span a microsecond to over a minute. */
+class TimeHistogram {
+public:
+  auto add(double seconds) -> void;
+
+  /* The duration at or below which fraction Q of those added fall, to
+     within a bucket. Zero when empty. */
+  auto percentile(double q) const -> double;
+  inline auto count() const { return count_; }
+  inline auto max() const { return max_; }
+
+private:
+  static constexpr int buckets_per_octave = 16;
+  static constexpr int bucket_count = 26 * buckets_per_octave;
+
+  std::array<std::uint64_t, bucket_count> buckets_{};
+  std::uint64_t count_{0};
+  double max_{0.0};
+};
+
+struct FrameTimerOptions {
+  /* Write every frame's timings to this file as CSV, in milliseconds, if
+     not empty. */
+  std::string csv_path{};
+};
+
+/* Times each frame of a viewer: the CPU time of every FrameStage, and the
+   GPU time of the draw calls through GL_TIME_ELAPSED queries.
+
+   Query results are read a few frames later, when the GPU has got to them,
+   so timing never stalls the pipeline; a frame is counted (and written to
+   the CSV file) once its GPU time is known. Frames begun but not ended,
+   such as loop iterations with nothing to draw, are dropped.
+
+   Must be created, used and destroyed with the GL context current. */
+class FrameTimer {
+public:
+  explicit FrameTimer(FrameTimerOptions options = {});
+  ~FrameTimer();
+
+  FrameTimer(const FrameTimer&) = delete;
+  auto operator=(const FrameTimer&) -> FrameTimer& = delete;
+
+  auto begin_frame() -> void;
+  /* End STAGE of the current frame, which began when the stage before it
+     ended or, for the first, when the frame began. */
+  auto end_stage(FrameStage stage) -> void;
+  /* Bracket the draw calls of the current frame to time them on the GPU. */
+  auto begin_gpu() -> void;
+  auto end_gpu() -> void;
+  auto end_frame() -> void;
+
+  inline auto stage(FrameStage stage) const -> const TimeHistogram& {
+    return stages_[static_cast<int>(stage)];
+  }
+  inline auto frame() const -> const TimeHistogram& { return frame_; }
+  inline auto gpu() const -> const TimeHistogram& { return gpu_; }
+
+  /* Write p50, p90, p99 and the maximum of every stage, the whole frame
+     and the GPU time to OUT, one per line. */
+  auto report(std::ostream& out) const -> void;
+  /* p50 and p99 of the whole frame and the GPU time on one line, for a
+     window title or overlay. */
+  auto summary() const -> std::string;
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t query_count = 4;
+
+  struct Frame {
+    std::array<double, frame_stage_count> stages{};
+    double total{0.0};
+    /* Index into queries_, or none if the frame drew nothing. */
+    int query{-1};
+  };
+
+  /* Count the oldest ended frames whose GPU time is known; with WAIT, wait
+     for the oldest one's. */
+  auto collect(bool wait) -> void;
+  auto record(const Frame& frame, double gpu_seconds) -> void;
+
+  std::array<GLuint, query_count> queries_{};
+  std::size_t next_query_{0};
+  /* Ended frames waiting for their GPU time, oldest first. */
+  std::deque<Frame> pending_;
+  Frame current_{};
+  bool in_frame_{false};
+  Clock::time_point frame_start_{};
+  Clock::time_point stage_start_{};
+
+  std::array<TimeHistogram, frame_stage_count> stages_{};
+  TimeHistogram frame_;
+  TimeHistogram gpu_;
+  std::uint64_t frames_{0};
+  std::ofstream csv_;
+};
+
+#endif /* WORMHOLE_FRAME_TIMER_HPP__ */
@@ -0,0 +1,94 @@
+#ifndef WORMHOLE_GL_EXTENSIONS_HPP__
+#define WORMHOLE_GL_EXTENSIONS_HPP__
+
+#include <glad/gl.h>
+
+/* glad is generated for the GL 3.3 core profile. Newer entry points are
+   loaded here at run time, after gladLoadGL, when the driver offers them;
+   callers check the pointer (or flag) and fall back to 3.3 otherwise. */
+
+/* GL 4.4 / ARB_buffer_storage. */
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+/* EXT_texture_compression_s3tc, ARB_texture_compression_bptc (GL 4.2) and
+   ARB_ES3_compatibility (GL 4.3), for compressed textures. */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+#endif
+
+/* GL 4.1 / ARB_get_program_binary. */
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+/* KHR_parallel_shader_compile and ARB_parallel_shader_compile. */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct GLExtensions {
+  void(GLAD_API_PTR* buffer_storage)(GLenum target, GLsizeiptr size,
+                                     const void* data,
+                                     GLbitfield flags){nullptr};
+
+  /* ARB_bindless_texture: textures addressed by 64-bit handles instead
+     of texture units. */
+  GLuint64(GLAD_API_PTR* get_texture_handle)(GLuint texture){nullptr};
+  void(GLAD_API_PTR* make_texture_handle_resident)(GLuint64 handle){nullptr};
+  void(GLAD_API_PTR* uniform_handle)(GLint location, GLuint64 value){nullptr};
+
+  /* ARB_get_program_binary, if the driver has any binary format: linked
+     programs saved and reloaded without compiling. */
+  void(GLAD_API_PTR* get_program_binary)(GLuint program, GLsizei buf_size,
+                                         GLsizei* length,
+                                         GLenum* binary_format,
+                                         void* binary){nullptr};
+  void(GLAD_API_PTR* program_binary)(GLuint program, GLenum binary_format,
+                                     const void* binary,
+                                     GLsizei length){nullptr};
+  void(GLAD_API_PTR* program_parameteri)(GLuint program, GLenum pname,
+                                         GLint value){nullptr};
+
+  /* KHR_parallel_shader_compile (or the ARB one): compiles and links run
+     on driver threads, and whether they are done can be polled with
+     GL_COMPLETION_STATUS_KHR instead of waited for. */
+  void(GLAD_API_PTR* max_shader_compiler_threads)(GLuint count){nullptr};
+
+  /* Compressed formats glCompressedTexImage2D accepts. */
+  bool s3tc{false};
+  bool bptc{false};
+  bool etc2{false};
+};
+
+/* Load the entry points above with LOAD (glfwGetProcAddress). Needs a
+   current context. */
+auto load_gl_extensions(GLADloadfunc load) -> void;
+
+/* The entry points found by load_gl_extensions. */
+auto gl_extensions() -> const GLExtensions&;
+
+#endif /* WORMHOLE_GL_EXTENSIONS_HPP__ */
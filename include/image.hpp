@@ -0,0 +1,20 @@
+#ifndef WORMHOLE_IMAGE_HPP__
+#define WORMHOLE_IMAGE_HPP__
+
+#include <cstddef>
+#include <vector>
+
+/* 8-bit pixels in the interleaved, row-major layout stbi_load produces. */
+struct Image {
+  int width;
+  int height;
+  int channels;
+  std::vector<unsigned char> data;
+
+  inline auto texel(int x, int y) const -> const unsigned char* {
+    return data.data() +
+           (static_cast<std::size_t>(y) * width + x) * channels;
+  }
+};
+
+#endif /* WORMHOLE_IMAGE_HPP__ */
@@ -0,0 +1,89 @@
+#ifndef WORMHOLE_INPUT_RECORDING_HPP__
+#define WORMHOLE_INPUT_RECORDING_HPP__
+
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "tracer.hpp"
+
+/* Which way the viewer's camera keys point: W/S along l (through the
+   throat), A/D around it, and the arrow keys to look around. Each is -1, 0
+   or 1. */
+struct CameraKeys {
+  double along{0.0};
+  double around{0.0};
+  double yaw{0.0};
+  double pitch{0.0};
+
+  inline auto held() const -> bool {
+    return along != 0.0 || around != 0.0 || yaw != 0.0 || pitch != 0.0;
+  }
+  auto operator==(const CameraKeys&) const -> bool = default;
+};
+
+/* The viewer's input at one moment: the keys held, the camera pose they
+   moved it to, and the size of the framebuffer. */
+struct InputSample {
+  /* Seconds since recording started. */
+  double time;
+  CameraKeys keys;
+  Camera camera;
+  int width;
+  int height;
+};
+
+/* Writes the viewer's input to a file as it changes, one InputSample per
+   line, for InputReplay to play back. Poses are written exactly, so a
+   replay follows the same camera path whatever its frame rate. */
+class InputRecorder {
+public:
+  /* Returns nothing if FILE_PATH can't be written. */
+  static auto create(std::string_view file_path)
+      -> std::optional<InputRecorder>;
+
+  auto record(const InputSample& sample) -> void;
+
+private:
+  explicit InputRecorder(std::ofstream out);
+
+  std::ofstream out_;
+};
+
+/* Plays back input written by InputRecorder in real time: the viewer asks
+   for the input at its current time and gets the next sample once it is
+   due. Every sample is played, in order, even when the viewer falls
+   behind, so two replays of one recording request the same frames. */
+class InputReplay {
+public:
+  /* Returns nothing, with an error printed, if FILE_PATH can't be read or
+     holds no samples. */
+  static auto from_file(std::string_view file_path)
+      -> std::optional<InputReplay>;
+
+  /* Move to the next sample if it is due at TIME, in seconds since the
+     replay started. Never skips a sample: one that fell behind is played
+     late instead, one per call. Returns whether it moved. */
+  auto advance(double time) -> bool;
+
+  /* The sample advanced to; the first one before any is due. */
+  inline auto current() const -> const InputSample& {
+    return samples_[current_];
+  }
+  /* When the next sample is due, if there is one. */
+  auto next_time() const -> std::optional<double>;
+  /* Whether every sample has been advanced to. */
+  inline auto finished() const -> bool {
+    return current_ + 1 == samples_.size();
+  }
+
+private:
+  explicit InputReplay(std::vector<InputSample> samples);
+
+  std::vector<InputSample> samples_;
+  std::size_t current_{0};
+};
+
+#endif /* WORMHOLE_INPUT_RECORDING_HPP__ */
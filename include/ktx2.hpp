@@ -0,0 +1,82 @@
+#ifndef WORMHOLE_KTX2_HPP__
+#define WORMHOLE_KTX2_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+/* The block-compressed formats read and written here, by their Vulkan
+   format numbers (which is how KTX2 names formats). All use 4x4 blocks. */
+enum class BlockFormat : std::uint32_t {
+  Bc1Rgb = 131,
+  Bc1RgbSrgb = 132,
+  Bc3Rgba = 137,
+  Bc3RgbaSrgb = 138,
+  Bc7Rgba = 145,
+  Bc7RgbaSrgb = 146,
+  Etc2Rgb = 147,
+  Etc2RgbSrgb = 148,
+  Etc2Rgba = 151,
+  Etc2RgbaSrgb = 152,
+};
+
+inline constexpr int block_size = 4;
+
+/* Bytes per 4x4 block of FORMAT. */
+auto block_bytes(BlockFormat format) -> std::size_t;
+
+/* Bytes of one WIDTH x HEIGHT image in FORMAT. */
+auto compressed_size(BlockFormat format, int width, int height)
+    -> std::size_t;
+
+/* One mip level; a cube map's six faces follow each other in GL face
+   order, FACE_SIZE bytes apart. */
+struct Ktx2Level {
+  int width;
+  int height;
+  const unsigned char* data;
+  std::size_t face_size;
+};
+
+/* A KTX2 file (2D or cube map, no array layers or supercompression) in a
+   block-compressed format, mapped so its levels can be handed straight to
+   glCompressedTexImage2D. */
+class Ktx2Texture {
+public:
+  /* Map FILE_PATH; exits if it isn't a KTX2 file this reader handles. */
+  static auto open(std::string_view file_path) -> Ktx2Texture;
+
+  inline auto format() const { return format_; }
+  inline auto faces() const { return faces_; }
+  /* Level 0 first. */
+  inline auto levels() const -> const std::vector<Ktx2Level>& {
+    return levels_;
+  }
+
+private:
+  Ktx2Texture() = default;
+
+  BlockFormat format_{BlockFormat::Bc1Rgb};
+  int faces_{1};
+  std::vector<Ktx2Level> levels_;
+  std::optional<MappedFile> file_;
+};
+
+/* One mip level to write: every face's blocks, back to back. */
+struct Ktx2Image {
+  int width;
+  int height;
+  std::vector<unsigned char> data;
+};
+
+/* Write LEVELS (level 0 first) of a FACES-face texture in FORMAT to
+   FILE_PATH. Only Bc1Rgb and Bc1RgbSrgb, the formats sky_compress
+   produces, can be written. Returns false if the file can't be written. */
+auto write_ktx2(std::string_view file_path, BlockFormat format, int faces,
+                const std::vector<Ktx2Image>& levels) -> bool;
+
+#endif /* WORMHOLE_KTX2_HPP__ */
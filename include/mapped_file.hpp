@@ -0,0 +1,41 @@
+#ifndef WORMHOLE_MAPPED_FILE_HPP__
+#define WORMHOLE_MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+/* A whole file mapped read-only. Pages are read from disk when first
+   touched rather than up front, and stay shared with the kernel's page
+   cache. */
+class MappedFile {
+public:
+  /* Map FILE_PATH; nullopt if it can't be opened or mapped. */
+  static auto open(std::string_view file_path) -> std::optional<MappedFile>;
+
+  MappedFile(const MappedFile&) = delete;
+  auto operator=(const MappedFile&) -> MappedFile& = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+  ~MappedFile();
+
+  inline auto data() const -> const unsigned char* {
+    return static_cast<const unsigned char*>(data_);
+  }
+  inline auto size() const { return size_; }
+
+  /* Hint that pages will be touched in no particular order, so the kernel
+     shouldn't read ahead of them. */
+  auto advise_random() const -> void;
+  /* Release the whole pages inside [OFFSET, OFFSET + LENGTH) from memory;
+     they are read back in if touched again. */
+  auto release(std::size_t offset, std::size_t length) const -> void;
+
+private:
+  MappedFile() = default;
+
+  void* data_{nullptr};
+  std::size_t size_{0};
+};
+
+#endif /* WORMHOLE_MAPPED_FILE_HPP__ */
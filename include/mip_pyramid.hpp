@@ -0,0 +1,20 @@
+#ifndef WORMHOLE_MIP_PYRAMID_HPP__
+#define WORMHOLE_MIP_PYRAMID_HPP__
+
+#include <vector>
+
+#include "image.hpp"
+
+/* Reconstruction filter used to halve each level. Box averages 2x2 texels;
+   Kaiser is a Kaiser-windowed sinc over 6x6 texels, which keeps star fields
+   sharper in the coarse levels without the ringing of a plain sinc. */
+enum class MipFilter { Box, Kaiser };
+
+/* Build the mip chain of BASE, down to 1x1. Level 0 is BASE itself.
+   Filtering clamps at the top and bottom edges; with WRAP_X it wraps
+   horizontally, as an equirectangular sky does across the dateline, and
+   otherwise clamps there too (cube map faces). */
+auto build_mip_pyramid(Image base, MipFilter filter, bool wrap_x = true)
+    -> std::vector<Image>;
+
+#endif /* WORMHOLE_MIP_PYRAMID_HPP__ */
@@ -0,0 +1,13 @@
+#ifndef WORMHOLE_PARALLEL_HPP__
+#define WORMHOLE_PARALLEL_HPP__
+
+#include <cstddef>
+#include <functional>
+
+/* Call FN(i) for every i in [0, COUNT) across the machine's hardware threads
+   and return once all calls have finished. Indices are handed out one at a
+   time, so items of uneven cost (tiles near the throat) balance themselves. */
+auto parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn)
+    -> void;
+
+#endif /* WORMHOLE_PARALLEL_HPP__ */
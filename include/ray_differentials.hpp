@@ -0,0 +1,19 @@
+#ifndef WORMHOLE_RAY_DIFFERENTIALS_HPP__
+#define WORMHOLE_RAY_DIFFERENTIALS_HPP__
+
+#include <cstddef>
+
+#include "sky_map.hpp"
+#include "tracer.hpp"
+
+/* Fill in the footprint of every pixel of MAP, which must already hold the
+   sky samples for CAMERA.
+
+   Where the map is coherent around a pixel the differential is the central
+   difference of its neighbours, which costs nothing. Across the throat
+   silhouette or where the neighbours disagree (the Einstein ring), a small
+   ray bundle is traced instead: two rays offset by a fraction of a pixel in
+   x and y. Returns the number of extra rays traced. */
+auto compute_differentials(const Camera& camera, SkyMap& map) -> std::size_t;
+
+#endif /* WORMHOLE_RAY_DIFFERENTIALS_HPP__ */
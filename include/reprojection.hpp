@@ -0,0 +1,34 @@
+#ifndef WORMHOLE_REPROJECTION_HPP__
+#define WORMHOLE_REPROJECTION_HPP__
+
+#include <cstddef>
+#include <optional>
+
+#include "sky_map.hpp"
+#include "tracer.hpp"
+
+struct ReprojectionStats {
+  std::size_t reused{0};
+  std::size_t traced{0};
+};
+
+/* Fill MAP for CAMERA by reusing PREVIOUS, a whole image traced for
+   PREVIOUS_CAMERA with its footprints computed, and tracing only the pixels
+   it can't provide.
+
+   The wormhole is spherically symmetric, so two cameras at the same l see
+   the same map up to a rotation: looking around, orbiting the throat and
+   zooming all just move the previous samples across the image. Each pixel's
+   ray is rotated back into the previous frame and its sample interpolated
+   from the four nearest previous pixels. Pixels whose ray leaves the
+   previous image, and pixels whose neighbours differ by more than their
+   footprints predict (across the throat silhouette and the Einstein ring,
+   or between universes) are traced instead.
+
+   Moving along l changes the map itself; returns nothing then, leaving MAP
+   untouched, and MAP must be traced from scratch. */
+auto reproject(const Camera& previous_camera, const SkyMap& previous,
+               const Camera& camera, SkyMap& map)
+    -> std::optional<ReprojectionStats>;
+
+#endif /* WORMHOLE_REPROJECTION_HPP__ */
@@ -0,0 +1,46 @@
+#ifndef WORMHOLE_RESOLUTION_GOVERNOR_HPP__
+#define WORMHOLE_RESOLUTION_GOVERNOR_HPP__
+
+#include <utility>
+
+struct ResolutionGovernorOptions {
+  /* Time a frame should take, in seconds. */
+  double target_seconds{1.0 / 30.0};
+  /* Bounds of the render resolution, as a fraction of the window's. */
+  double min_scale{0.25};
+  double max_scale{1.0};
+  /* Frames within this fraction of the target leave the scale alone, so
+     it doesn't hunt around the target. */
+  double tolerance{0.2};
+  /* Weight of the newest frame in the running frame time. */
+  double smoothing{0.3};
+};
+
+/* Picks the resolution to render at so frames keep to a time budget, for
+   scenes whose cost varies a lot with the view, such as the camera closing
+   in on the throat.
+
+   Frame time is taken to grow with the pixel count, so after each frame the
+   scale is moved by the square root of how far the running frame time is
+   from the target. Scales are rounded to steps of 1/20 of the window so
+   small changes don't resize the frame every time. */
+class ResolutionGovernor {
+public:
+  explicit ResolutionGovernor(ResolutionGovernorOptions options = {});
+
+  /* Report that a frame rendered at the current scale took SECONDS. */
+  auto report(double seconds) -> void;
+
+  inline auto scale() const { return scale_; }
+  /* The size to render at for a WIDTH x HEIGHT window, at least 1 x 1. */
+  auto resolution(int width, int height) const -> std::pair<int, int>;
+
+private:
+  ResolutionGovernorOptions options_;
+  double scale_;
+  /* Running frame time since the scale last changed; zero before the first
+     frame at this scale. */
+  double seconds_{0.0};
+};
+
+#endif /* WORMHOLE_RESOLUTION_GOVERNOR_HPP__ */
@@ -0,0 +1,25 @@
+#ifndef WORMHOLE_SAMPLE_SEQUENCE_HPP__
+#define WORMHOLE_SAMPLE_SEQUENCE_HPP__
+
+#include <cstdint>
+#include <utility>
+
+/* Point INDEX of the two dimensional Sobol sequence, shuffled and
+   Owen-scrambled by SEED (Burley, "Practical Hash-based Owen Scrambling",
+   2020), in [0, 1)^2.
+
+   Any power of two prefix of the points is stratified in every elementary
+   interval, as in the plain sequence, so a pixel's samples cover it far
+   more evenly than random ones and its error falls off faster with the
+   sample count. Different seeds give decorrelated sequences, so
+   neighbouring pixels don't share a pattern that would show as structure
+   in the image. */
+auto sobol_2d(std::uint32_t index, std::uint32_t seed)
+    -> std::pair<double, double>;
+
+/* Seed for the samples of image pixel (X, Y). Depends on nothing else, so
+   a pixel gets the same samples however the image is split into tiles and
+   threads. */
+auto pixel_seed(int x, int y) -> std::uint32_t;
+
+#endif /* WORMHOLE_SAMPLE_SEQUENCE_HPP__ */
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "detail/globject.hpp"
 #include "texture.hpp"
@@ -21,7 +22,8 @@ public:
   Shader(Shader&&) = delete;
 
   /* Attempt to compile the shader. Returns whether it was successful.
-    Compilation errors printed to STDERR. */
+    Compilation errors printed to STDERR. Not needed before linking:
+    ShaderProgram::link compiles its shaders itself when it has to. */
   auto compile() -> bool;
 
   inline auto step() const -> ShaderStep { return step_; }
@@ -31,6 +33,12 @@ public:
   friend ShaderProgram;
 
 private:
+  /* Hand the source to the driver without waiting for the result. Returns
+     false if the shader couldn't be created. */
+  auto start_compile() -> bool;
+  /* Wait for the compile and print its errors. */
+  auto finish_compile() -> bool;
+
   std::string src_;
   ShaderStep step_;
 };
@@ -42,11 +50,33 @@ public:
   ShaderProgram(const ShaderProgram&) = delete;
   ShaderProgram(ShaderProgram&&) = delete;
 
-  /* Attach the shader to the program. */
-  auto attach(const Shader& shader) -> ShaderProgram&;
+  /* Attach the shader to the program. The shader must outlive link. */
+  auto attach(Shader& shader) -> ShaderProgram&;
+
+  /* Link the program, compiling any attached shader not yet compiled;
+     start_link then finish_link.
+
+     With CACHE_DIRECTORY, the linked program binary is saved there, keyed
+     by a hash of the shaders' sources (#defines included) and the driver,
+     and later links of the same sources load it instead of compiling. A
+     binary the driver rejects, such as after a driver update, is rebuilt.
+     Without ARB_get_program_binary the cache is ignored. */
+  auto link(std::string_view cache_directory = {}) -> bool;
+
+  /* Start linking as link does, without waiting for the driver to compile
+     or link. Start every program before finishing any, so that drivers
+     with KHR_parallel_shader_compile build them all at once across their
+     threads and the others at least don't stop after each shader. */
+  auto start_link(std::string_view cache_directory = {}) -> void;
+
+  /* Whether the started link is done, so finish_link won't wait: for
+     drawing something else meanwhile. Always true without
+     KHR_parallel_shader_compile, which is needed to ask. */
+  auto link_ready() const -> bool;
 
-  /* Link the program. */
-  auto link() -> bool;
+  /* Wait for the started link. Returns whether it was successful; errors
+     printed to STDERR. */
+  auto finish_link() -> bool;
 
   /* Use (activate) the program. */
   auto use() -> void;
@@ -54,6 +84,25 @@ public:
   /* Set a texture uniform using TEXTURE with name UNIFORM_NAME. */
   auto set_texture_uniform(const Texture& texture,
                            std::string_view uniform_name) -> void;
+
+  /* Set a sampler2DArray uniform to TEXTURES: to its bindless handle if it
+     has one and the program's shaders enable GL_ARB_bindless_texture,
+     otherwise to the unit it is bound to. The program must be in use. */
+  auto set_texture_uniform(const TextureArray& textures,
+                           std::string_view uniform_name) -> void;
+
+  /* Set the int uniform UNIFORM_NAME selecting a texture array layer. The
+     program must be in use. */
+  auto set_layer_uniform(int layer, std::string_view uniform_name) -> void;
+
+private:
+  std::vector<Shader*> shaders_;
+  /* State of the link started last. */
+  std::string cache_path_;
+  bool from_cache_{false};
+  bool start_failed_{false};
+  /* Whether an attached shader enables GL_ARB_bindless_texture. */
+  bool bindless_{false};
 };
 
 #endif /* WORMHOLE_SHADER_HPP__ */
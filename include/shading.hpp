@@ -0,0 +1,21 @@
+#ifndef WORMHOLE_SHADING_HPP__
+#define WORMHOLE_SHADING_HPP__
+
+#include <vector>
+
+#include "sky_map.hpp"
+#include "sky_texture.hpp"
+
+/* How shade filters each pixel's footprint. Ewa is sharper across strongly
+   stretched footprints; Trilinear runs through the batched gather kernel and
+   is several times cheaper. */
+enum class SkyFilter { Ewa, Trilinear };
+
+/* Look up every pixel of MAP in the sky of the universe it sees, filtered
+   over the pixel's footprint. Returns tightly packed sRGB RGBA8 rows, top row
+   first. */
+auto shade(const SkyMap& map, const SkyTexture& upper_sky,
+           const SkyTexture& lower_sky, SkyFilter filter = SkyFilter::Ewa)
+    -> std::vector<unsigned char>;
+
+#endif /* WORMHOLE_SHADING_HPP__ */
@@ -0,0 +1,43 @@
+#ifndef WORMHOLE_SKY_GATHER_HPP__
+#define WORMHOLE_SKY_GATHER_HPP__
+
+#include <vector>
+
+#include "image.hpp"
+#include "tiled_image.hpp"
+
+/* Number of lookups handled by one call of the gather kernels. */
+inline constexpr int gather_width = 8;
+
+/* Equirectangular lookups, structure-of-arrays. lod is only read by the
+   trilinear kernel. */
+struct UVBatch {
+  float u[gather_width];
+  float v[gather_width];
+  float lod[gather_width];
+};
+
+/* Linear colors, structure-of-arrays. */
+struct ColorBatch {
+  float r[gather_width];
+  float g[gather_width];
+  float b[gather_width];
+  float a[gather_width];
+};
+
+/* Bilinear lookups of IMAGE at the gather_width positions of UV. The address
+   arithmetic, dateline wrap and pole clamp, and blending run on all lanes at
+   once; texels are read straight from the 1, 2, 3 or 4-channel sRGB bytes
+   stbi_load produces and decoded to linear through srgb_to_linear_table. */
+auto gather_bilinear(const Image& image, const UVBatch& uv, ColorBatch& out)
+    -> void;
+
+/* Trilinear lookups into the mip chain LEVELS, each lane at its own lod. */
+auto gather_trilinear(const std::vector<Image>& levels, const UVBatch& uv,
+                      ColorBatch& out) -> void;
+
+/* As above on tiled levels; each bilinear footprint reads one tile. */
+auto gather_trilinear(const std::vector<TiledImage>& levels,
+                      const UVBatch& uv, ColorBatch& out) -> void;
+
+#endif /* WORMHOLE_SKY_GATHER_HPP__ */
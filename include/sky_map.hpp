@@ -0,0 +1,82 @@
+#ifndef WORMHOLE_SKY_MAP_HPP__
+#define WORMHOLE_SKY_MAP_HPP__
+
+#include <cstddef>
+#include <vector>
+
+#include "tracer.hpp"
+
+/* Ray differential of a pixel: how its sky direction changes per pixel step
+   in x and y. Together they span the pixel's footprint on the sky. A zero
+   footprint means the pixel is point sampled. */
+struct SkyFootprint {
+  Vec3 dx;
+  Vec3 dy;
+};
+
+/* Which pixels of an IMAGE_WIDTH x IMAGE_HEIGHT image a SkyMap holds: map
+   pixel (x, y) is image pixel (origin_x + x * stride, origin_y + y * stride)
+   and is traced through that pixel's center. */
+struct ImageWindow {
+  int image_width;
+  int image_height;
+  int origin_x{0};
+  int origin_y{0};
+  /* Image pixels between neighbouring map pixels. */
+  int stride{1};
+};
+
+/* Per-pixel result of tracing an image: which universe each pixel sees and
+   where on that universe's sky it looks. Row-major.
+
+   A map may also cover just a window of a larger image, such as one tile of
+   a frame rendered tile by tile, or every stride-th pixel of it, such as one
+   pass of a progressive render. Footprints are then per map pixel, so a
+   strided map's footprints span STRIDE image pixels. */
+class SkyMap {
+public:
+  SkyMap() = default;
+  SkyMap(int width, int height)
+      : SkyMap{width, height,
+               {.image_width = width, .image_height = height}} {}
+  SkyMap(int width, int height, const ImageWindow& window)
+      : width_{width},
+        height_{height},
+        window_{window},
+        samples_(static_cast<std::size_t>(width) * height),
+        footprints_(samples_.size()) {}
+
+  inline auto width() const { return width_; }
+  inline auto height() const { return height_; }
+  inline auto window() const -> const ImageWindow& { return window_; }
+  /* Image coordinates of the center of map pixel (X, Y). */
+  inline auto image_x(double x) const {
+    return window_.origin_x + x * window_.stride + 0.5;
+  }
+  inline auto image_y(double y) const {
+    return window_.origin_y + y * window_.stride + 0.5;
+  }
+
+  inline auto at(int x, int y) -> SkySample& {
+    return samples_[static_cast<std::size_t>(y) * width_ + x];
+  }
+  inline auto at(int x, int y) const -> const SkySample& {
+    return samples_[static_cast<std::size_t>(y) * width_ + x];
+  }
+
+  inline auto footprint(int x, int y) -> SkyFootprint& {
+    return footprints_[static_cast<std::size_t>(y) * width_ + x];
+  }
+  inline auto footprint(int x, int y) const -> const SkyFootprint& {
+    return footprints_[static_cast<std::size_t>(y) * width_ + x];
+  }
+
+private:
+  int width_{0};
+  int height_{0};
+  ImageWindow window_{};
+  std::vector<SkySample> samples_;
+  std::vector<SkyFootprint> footprints_;
+};
+
+#endif /* WORMHOLE_SKY_MAP_HPP__ */
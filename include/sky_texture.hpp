@@ -0,0 +1,122 @@
+#ifndef WORMHOLE_SKY_TEXTURE_HPP__
+#define WORMHOLE_SKY_TEXTURE_HPP__
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "color.hpp"
+#include "cubemap.hpp"
+#include "equirect.hpp"
+#include "image.hpp"
+#include "mip_pyramid.hpp"
+#include "sky_gather.hpp"
+#include "sky_map.hpp"
+#include "tiled_image.hpp"
+#include "vec3.hpp"
+#include "virtual_texture.hpp"
+
+/* How a SkyTexture stores its panorama. TiledEquirect keeps the
+   equirectangular mapping but stores each level as a TiledImage, trading a
+   re-layout pass at load time for far fewer cache misses on lensed lookups.
+   Cubemap resamples the panorama into six faces at load time, so lookups
+   need no atan2/acos and stay cache-friendly near the poles. Virtual reads
+   an equirectangular panorama tiled offline into a VirtualTexture, paging
+   tiles in as lookups touch them. */
+enum class SkyLayout { Equirect, TiledEquirect, Cubemap, Virtual };
+
+/* CPU-side copy of a sky panorama for the CPU renderer. Unlike Texture it
+   keeps its pixels and a mip pyramid, so lookups can be prefiltered over a
+   pixel's footprint. */
+class SkyTexture {
+public:
+  /* Bytes of a tile file from_file keeps resident between frames. */
+  static constexpr std::size_t default_resident_budget = 256 << 20;
+
+  /* Load the panorama at FILE_PATH. A tile file written by tools/sky_tiler
+     (FILE.vtex) is opened with from_virtual and default_resident_budget
+     instead; it carries its own mips, so FILTER and LAYOUT don't apply.
+     Returns nothing, with an error printed, if the file can't be loaded, so
+     a load on a worker thread can leave exiting to the main thread. */
+  static auto from_file(std::string_view file_path,
+                        MipFilter filter = MipFilter::Kaiser,
+                        SkyLayout layout = SkyLayout::Equirect)
+      -> std::optional<SkyTexture>;
+  static auto from_pixels(int width, int height, int channels,
+                          const unsigned char* data,
+                          MipFilter filter = MipFilter::Kaiser,
+                          SkyLayout layout = SkyLayout::Equirect)
+      -> SkyTexture;
+  /* Page the tile file written by tools/sky_tiler in on demand, keeping
+     about RESIDENT_BUDGET bytes of it in memory between frames. Returns
+     nothing, with an error printed, if it is missing or corrupt. */
+  static auto from_virtual(std::string_view file_path,
+                           std::size_t resident_budget)
+      -> std::optional<SkyTexture>;
+
+  /* The (SkyUV, UVFootprint) lookups below address the equirectangular
+     levels and need an equirectangular layout: anything but SkyLayout::Cubemap. */
+
+  /* Sample at UV with an elliptical weighted average over FOOTPRINT. The
+     ellipse is filtered on the two levels matching its minor axis, so
+     strongly stretched footprints (the tangentially smeared Einstein ring)
+     stay sharp across the ring instead of blurring to their major axis. */
+  auto sample(SkyUV uv, const UVFootprint& footprint) const -> Color;
+
+  /* Cheaper isotropic alternative to sample: one trilinear lookup at the
+     level of detail matching the footprint's longer axis. */
+  auto sample_trilinear(SkyUV uv, const UVFootprint& footprint) const
+      -> Color;
+
+  /* sample_trilinear for gather_width lookups at once. The lod of each lane
+     comes from level_of_detail. A Virtual layout looks lanes up one by
+     one. */
+  auto sample_trilinear(const UVBatch& uv, ColorBatch& out) const -> void;
+
+  /* Mip level matching the longer axis of FOOTPRINT. */
+  auto level_of_detail(const UVFootprint& footprint) const -> double;
+
+  /* Sample the sky in DIRECTION for a pixel with sky FOOTPRINT: EWA for
+     an equirectangular texture, trilinear on the face for a cube map. */
+  auto sample(Vec3 direction, const SkyFootprint& footprint) const -> Color;
+
+  /* Let a Virtual layout evict tiles the frame just rendered didn't need.
+     Call between frames, never while sampling. No-op for other layouts. */
+  auto end_frame() const -> void;
+
+  inline auto layout() const { return layout_; }
+  /* Row-major levels; empty unless the layout is SkyLayout::Equirect. */
+  inline auto levels() const -> const std::vector<Image>& { return levels_; }
+  inline auto tiled_levels() const -> const std::vector<TiledImage>& {
+    return tiled_levels_;
+  }
+  inline auto face_levels(int face) const -> const std::vector<Image>& {
+    return faces_[face];
+  }
+
+private:
+  /* Equirectangular layouts from a prebuilt mip chain. */
+  static auto from_levels(std::vector<Image> levels, SkyLayout layout)
+      -> SkyTexture;
+
+  auto level_count() const -> std::size_t;
+  auto base_width() const -> int;
+  auto base_height() const -> int;
+  auto sample_cubemap(Vec3 direction, const SkyFootprint& footprint) const
+      -> Color;
+
+  auto bilinear(int level, SkyUV uv) const -> Color;
+  auto ewa(int level, SkyUV uv, double du0, double dv0, double du1,
+           double dv1) const -> Color;
+
+  SkyLayout layout_{SkyLayout::Equirect};
+  std::vector<Image> levels_;
+  std::vector<TiledImage> tiled_levels_;
+  std::array<std::vector<Image>, cube_faces> faces_;
+  std::shared_ptr<VirtualTexture> virtual_;
+};
+
+#endif /* WORMHOLE_SKY_TEXTURE_HPP__ */
@@ -0,0 +1,43 @@
+#ifndef WORMHOLE_SRGB_HPP__
+#define WORMHOLE_SRGB_HPP__
+
+#include <array>
+
+/* Sky images are stored as 8-bit sRGB, but filtering and blending must
+   happen on linear values or dark star fields lose energy as they are
+   averaged down. Both directions go through tables. */
+extern const std::array<float, 256> srgb_to_linear_table;
+
+/* Linear [0, 1] quantized to this many steps when encoding. */
+inline constexpr int linear_to_srgb_steps = 4096;
+extern const std::array<unsigned char, linear_to_srgb_steps>
+    linear_to_srgb_table;
+
+inline auto srgb_to_linear(unsigned char value) -> float {
+  return srgb_to_linear_table[value];
+}
+
+inline auto linear_to_srgb(float value) -> unsigned char {
+  const float scaled = value * (linear_to_srgb_steps - 1) + 0.5f;
+  if (!(scaled > 0.0f)) return linear_to_srgb_table.front();
+  if (scaled >= linear_to_srgb_steps - 1) return linear_to_srgb_table.back();
+  return linear_to_srgb_table[static_cast<int>(scaled)];
+}
+
+/* Alpha is stored linearly. */
+inline auto alpha_to_float(unsigned char value) -> float {
+  return value * (1.0f / 255.0f);
+}
+
+inline auto float_to_alpha(float value) -> unsigned char {
+  if (!(value > 0.0f)) return 0;
+  if (value >= 1.0f) return 255;
+  return static_cast<unsigned char>(value * 255.0f + 0.5f);
+}
+
+/* Whether channel C of a CHANNELS-channel stbi image is alpha. */
+inline constexpr auto is_alpha_channel(int c, int channels) -> bool {
+  return (channels == 2 || channels == 4) && c == channels - 1;
+}
+
+#endif /* WORMHOLE_SRGB_HPP__ */
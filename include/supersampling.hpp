@@ -0,0 +1,25 @@
+#ifndef WORMHOLE_SUPERSAMPLING_HPP__
+#define WORMHOLE_SUPERSAMPLING_HPP__
+
+#include <cstddef>
+#include <vector>
+
+#include "sky_map.hpp"
+#include "sky_texture.hpp"
+#include "tracer.hpp"
+
+/* Re-render the pixels of MAP, shaded into RGBA (as returned by shade), that
+   its footprints can't filter: along the throat silhouette, where a pixel
+   sees both universes, and across other jumps in the map.
+
+   Each such pixel traces SAMPLES_PER_PIXEL rays placed by sobol_2d, seeded
+   per image pixel so stills come out the same for any tiling or thread
+   count, and averages their colors in linear light. Every ray still filters
+   over its share of the pixel's footprint. Returns the number of pixels
+   supersampled. */
+auto supersample_edges(const Camera& camera, const SkyMap& map,
+                       const SkyTexture& upper_sky,
+                       const SkyTexture& lower_sky, int samples_per_pixel,
+                       std::vector<unsigned char>& rgba) -> std::size_t;
+
+#endif /* WORMHOLE_SUPERSAMPLING_HPP__ */
@@ -1,23 +1,112 @@
 #ifndef WORMHOLE_TEXTURE_HPP__
 #define WORMHOLE_TEXTURE_HPP__
 
+#include <string>
 #include <string_view>
+#include <vector>
 
+#include "decoded_image.hpp"
 #include "detail/globject.hpp"
 
+/* How Texture::from_file uploads an image. CubeMap treats the image as an
+   equirectangular sky and converts it into the six faces of a
+   GL_TEXTURE_CUBE_MAP, which shaders sample with a direction instead of
+   computing atan2/acos per fragment. */
+enum class TextureTarget { Texture2D, CubeMap };
+
+class AnimatedTexture;
+class TextureArray;
+class TextureLoader;
+
 class Texture : private detail::GLObject {
 public:
   Texture();
   auto bind(int texture_unit) -> void;
   inline auto texture_unit() const { return texture_unit_; }
+  inline auto target() const { return target_; }
+
+  /* Load FILE_PATH. A .ktx2 file (see sky_compress) is uploaded in its
+     block-compressed format with its stored mip chain; TARGET must then
+     match the file, since a 6-face file already is a cube map. */
+  static auto from_file(std::string_view file_path,
+                        TextureTarget target = TextureTarget::Texture2D)
+      -> Texture;
+
+  /* Make this a WIDTH x HEIGHT CHANNELS-channel 2D texture cleared to zero,
+     to be filled in with update. Can be called again to resize. */
+  auto allocate(int width, int height, int channels) -> void;
+
+  /* Replace the WIDTH x HEIGHT texels at (X, Y) of a 2D texture's level 0
+     with the tightly packed rows at DATA, which has the texture's channel
+     count. Mipmaps are not regenerated. Leaves the texture bound to its
+     unit (or the active one, if it isn't bound). */
+  auto update(int x, int y, int width, int height, const unsigned char* data)
+      -> void;
+
+  inline auto width() const { return width_; }
+  inline auto height() const { return height_; }
 
-  static auto from_file(std::string_view file_path) -> Texture;
+  friend AnimatedTexture;
+  friend TextureArray;
+  friend TextureLoader;
+
+private:
+  static auto from_ktx2(std::string_view file_path, TextureTarget target)
+      -> Texture;
+  /* GL format of CHANNELS-channel pixels; exits if there is none. FILE_PATH
+     is only for the error message. */
+  static auto format_for(int channels, std::string_view file_path) -> GLenum;
+  /* Wrapping and filtering for the texture bound to TARGET. */
+  static auto set_sampling(GLenum target) -> void;
+  /* GL_TEXTUREi for TEXTURE_UNIT, checked against what the driver offers
+     (at least 48 units in GL 3.3). */
+  static auto translate(int texture_unit) -> GLenum;
+
+  int width_;
+  int height_;
+  int nr_channels_;
+  int texture_unit_{-1};
+  GLenum target_{GL_TEXTURE_2D};
+};
+
+/* Equally sized images in the layers of one GL_TEXTURE_2D_ARRAY, so a
+   shader reaches all of them (both universes' skies, the frames of an
+   animated sky, lookup tables) through a single binding and picks one by
+   layer index. Where ARB_bindless_texture is available the array also has
+   a resident handle, and shaders enabling that extension get the handle
+   instead of a texture unit and need no bind at all. */
+class TextureArray : private detail::GLObject {
+public:
+  /* Allocate LAYERS layers of WIDTH x HEIGHT CHANNELS-channel texels,
+     with room for the full mip chain. */
+  TextureArray(int width, int height, int channels, int layers);
+
+  /* Load FILE_PATHS into consecutive layers; exits unless they all have
+     the same size and channel count. */
+  static auto from_files(const std::vector<std::string>& file_paths)
+      -> TextureArray;
+
+  /* Replace LAYER with IMAGE, which must match the array's size and
+     channels. Call generate_mipmaps once the layers are updated. */
+  auto set_layer(int layer, const ImageView& image) -> void;
+  auto generate_mipmaps() -> void;
+
+  auto bind(int texture_unit) -> void;
+  inline auto texture_unit() const { return texture_unit_; }
+  inline auto layers() const { return layers_; }
+  inline auto width() const { return width_; }
+  inline auto height() const { return height_; }
+  /* The resident bindless handle, or 0 without ARB_bindless_texture. */
+  inline auto handle() const { return handle_; }
 
 private:
   int width_;
   int height_;
   int nr_channels_;
+  int layers_;
+  GLenum format_;
   int texture_unit_{-1};
+  GLuint64 handle_{0};
 };
 
 #endif /* WORMHOLE_TEXTURE_HPP__ */
@@ -0,0 +1,101 @@
+#ifndef WORMHOLE_TEXTURE_LOADER_HPP__
+#define WORMHOLE_TEXTURE_LOADER_HPP__
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "decoded_image.hpp"
+#include "detail/globject.hpp"
+#include "texture.hpp"
+
+struct TextureLoaderOptions {
+  /* Threads decoding images; each decodes one texture at a time. */
+  int decode_threads{2};
+  /* Most bytes of pixels copied into the upload buffer per update, which
+     bounds the time a frame spends on uploads. */
+  std::size_t upload_bytes_per_frame{16 << 20};
+  /* Show the thumbnail DecodedImage keeps next to the source, when there is
+     one, while the full image decodes and uploads. */
+  bool proxies{true};
+};
+
+/* Loads textures without stalling the render loop.
+
+   load returns a texture that can be bound straight away and shows a 1x1
+   grey placeholder. If an earlier load left a thumbnail next to the source,
+   it replaces the placeholder within a frame or two, long before the full
+   image; the texture is swapped again, transparently, when that lands.
+
+   Decoding (and the cube map conversion) runs on worker threads, several
+   textures at once. Each update then streams a bounded number of rows from
+   the decoded pixels through a ring of pixel buffer objects into a staging
+   texture. The ring is persistently mapped where
+   GL 4.4 buffer storage is available, and mapped per chunk otherwise.
+   Fences guard the ring segments, so update never waits on the GPU: a
+   segment still being read just defers the next chunk to the next frame.
+   Once the last chunk and the mipmaps are fenced off, the texture adopts
+   the staging texture, rebinding it to its unit if it was bound.
+
+   All members must be called on the thread owning the GL context, and the
+   context must still be current when the loader is destroyed. */
+class TextureLoader {
+public:
+  explicit TextureLoader(TextureLoaderOptions options = {});
+  ~TextureLoader();
+
+  TextureLoader(const TextureLoader&) = delete;
+  auto operator=(const TextureLoader&) -> TextureLoader& = delete;
+
+  /* Start loading FILE_PATH as Texture::from_file would. KTX2 files are
+     loaded on the spot instead: their blocks go to the GPU as stored. */
+  auto load(std::string_view file_path,
+            TextureTarget target = TextureTarget::Texture2D)
+      -> std::shared_ptr<Texture>;
+
+  /* Advance uploads and swap in finished textures. Call once per frame. */
+  auto update() -> void;
+
+  /* Textures requested but not yet swapped in. */
+  inline auto pending() const { return pending_; }
+
+private:
+  struct Job;
+
+  static constexpr std::size_t ring_segments = 4;
+  static constexpr std::size_t segment_bytes = 8 << 20;
+
+  auto decode_loop(std::stop_token stop) -> void;
+  /* Fill in JOB's surfaces from IMAGE, converting to a cube map if asked. */
+  static auto prepare(Job& job, DecodedImage image) -> void;
+  auto start_upload(Job& job) -> void;
+  /* Upload the next chunk of JOB into a free ring segment. Returns the
+     bytes uploaded, or 0 if no segment is free yet. */
+  auto upload_chunk(Job& job) -> std::size_t;
+
+  TextureLoaderOptions options_;
+  std::size_t pending_{0};
+
+  GLuint ring_{0};
+  unsigned char* ring_memory_{nullptr};
+  std::array<GLsync, ring_segments> ring_fences_{};
+  std::size_t next_segment_{0};
+
+  std::mutex mutex_;
+  std::condition_variable_any queued_cv_;
+  std::deque<std::unique_ptr<Job>> queued_;
+  std::deque<std::unique_ptr<Job>> decoded_;
+  /* Only touched on the GL thread. */
+  std::deque<std::unique_ptr<Job>> uploading_;
+
+  /* Last, so the workers stop before the queues go away. */
+  std::vector<std::jthread> workers_;
+};
+
+#endif /* WORMHOLE_TEXTURE_LOADER_HPP__ */
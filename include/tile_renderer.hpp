@@ -0,0 +1,161 @@
+#ifndef WORMHOLE_TILE_RENDERER_HPP__
+#define WORMHOLE_TILE_RENDERER_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "adaptive_sampler.hpp"
+#include "shading.hpp"
+#include "sky_texture.hpp"
+#include "tracer.hpp"
+#include "triple_buffer.hpp"
+
+struct TileRendererOptions {
+  /* Side of the square tiles a frame is split into, in pixels. */
+  int tile_size{64};
+  AdaptiveOptions sampling{};
+  SkyFilter filter{SkyFilter::Trilinear};
+  /* Render each frame in passes over the whole image instead of tile by
+     tile, for interactive preview. */
+  bool progressive{false};
+  /* Rays per pixel where the footprints can't filter the map (see
+     supersample_edges), in each tile or in the final progressive pass. */
+  int samples_per_pixel{1};
+  /* Called on the worker thread whenever a tile or pass is ready, such as
+     to wake a viewer waiting for events. */
+  std::function<void()> on_ready{};
+};
+
+/* A finished tile: RGBA8 rows of the frame, top row first, for the
+   WIDTH x HEIGHT pixels at (X, Y). */
+struct RenderedTile {
+  int x;
+  int y;
+  int width;
+  int height;
+  std::vector<unsigned char> rgba;
+};
+
+/* Renders frames with the CPU renderer on a background thread, one tile at
+   a time, so a viewer can show each tile as soon as it is done instead of
+   waiting for the whole frame.
+
+   Tiles are rendered from the center of the frame outwards. Each is traced
+   with a one pixel apron, so its ray differentials match those of a whole
+   frame render except along the image border, and each step of a tile
+   (sampling, differentials, shading) runs across all cores.
+
+   In progressive mode a frame is rendered in 16 passes instead, each
+   tracing one pixel of every 4x4 block, so the first pass is a 1/16
+   resolution image after 1/16 of the work. Each pass places its pixels
+   evenly between those already traced, and pixels not yet traced show the
+   nearest one that is. Samples are kept between passes, and a last pass
+   filters every pixel over its own footprint. Every pass is returned as one
+   tile covering the frame; finished_tiles only returns the latest.
+
+   While the camera only looks around, orbits or zooms, a progressive frame
+   starts from the last frame traced in full instead (see reproject),
+   tracing only the pixels that can't be reused, and is returned whole and
+   final right away, without any passes. Only once a frame has to trace
+   more than a quarter of its pixels that way is it traced in full again,
+   its passes running without being returned until the last replaces it.
+   Frames are never reprojected from reprojected ones, so errors from
+   reprojecting don't build up while the camera moves.
+
+   After every frame, finished or abandoned, skies paged in from tile files
+   get to evict the tiles it didn't use (see SkyTexture::end_frame).
+
+   Neither render nor the progressive finished_tiles ever wait for the
+   worker: requests and passes are handed over through triple buffers, so
+   a viewer can post a new camera every frame and always shows the newest
+   pass, however long one takes to trace. The last pass finished is returned
+   even if its frame has been superseded since, so a camera that keeps
+   moving still sees updates. */
+class TileRenderer {
+public:
+  /* The skies must outlive the renderer. */
+  TileRenderer(const SkyTexture& upper_sky, const SkyTexture& lower_sky,
+               TileRendererOptions options = {});
+
+  TileRenderer(const TileRenderer&) = delete;
+  auto operator=(const TileRenderer&) -> TileRenderer& = delete;
+
+  /* Start rendering a WIDTH x HEIGHT frame for CAMERA. A frame still in
+     progress is abandoned after its current tile (or pass), and none of its
+     tiles are returned any more (but see above for passes). render,
+     finished_tiles and done must all be called from the same thread. */
+  auto render(const Camera& camera, int width, int height) -> void;
+
+  /* Take the tiles finished since the last call. */
+  auto finished_tiles() -> std::vector<RenderedTile>;
+
+  /* Whether the tiles finished_tiles last returned belong to the frame
+     last passed to render, rather than to a superseded one (which only
+     happens to passes). */
+  inline auto current() const { return current_; }
+
+  /* Whether every tile (or pass) of the current frame has been taken. */
+  auto done() -> bool;
+
+private:
+  struct Frame {
+    Camera camera;
+    int width;
+    int height;
+    std::uint64_t generation;
+  };
+
+  struct Result {
+    std::uint64_t generation;
+    /* Tiles or passes of the frame still to come after this one. */
+    std::size_t remaining;
+    RenderedTile tile;
+  };
+
+  auto render_loop(std::stop_token stop) -> void;
+  auto render_tiles(const Frame& frame, const std::stop_token& stop) -> void;
+  auto render_passes(const Frame& frame, const std::stop_token& stop)
+      -> void;
+  /* Whether FRAME has been superseded. */
+  auto cancelled(const Frame& frame, const std::stop_token& stop) const
+      -> bool;
+  /* Hand over a pass of FRAME with REMAINING passes still to come. */
+  auto publish_pass(const Frame& frame, std::size_t remaining,
+                    RenderedTile tile) -> void;
+  auto render_tile(const Frame& frame, int x, int y, int width,
+                   int height) const -> RenderedTile;
+  auto wake_worker() -> void;
+  /* Let virtual skies evict the tiles the frame just traced didn't use. */
+  auto end_sky_frame() const -> void;
+
+  const SkyTexture& upper_sky_;
+  const SkyTexture& lower_sky_;
+  TileRendererOptions options_;
+  AdaptiveSampler sampler_;
+
+  /* Bumped by render; results of older frames are dropped. */
+  std::atomic<std::uint64_t> generation_{0};
+  TripleBuffer<Frame> requests_;
+  /* Bumped to wake the worker when there is a request or it should stop. */
+  std::atomic<std::uint32_t> wakeups_{0};
+  /* Tiles in tile mode; each has to be shown, so they are queued. */
+  std::mutex mutex_;
+  std::deque<Result> finished_;
+  /* Passes in progressive mode; only the latest has to be shown. */
+  TripleBuffer<Result> passes_;
+  std::size_t remaining_{0};
+  bool current_{true};
+  /* The last progressive frame the worker traced in full, to reproject. */
+  Camera traced_camera_{};
+  SkyMap traced_map_;
+
+  /* Last, so the worker stops before the buffers go away. */
+  std::jthread worker_;
+};
+
+#endif /* WORMHOLE_TILE_RENDERER_HPP__ */
@@ -0,0 +1,60 @@
+#ifndef WORMHOLE_TILED_IMAGE_HPP__
+#define WORMHOLE_TILED_IMAGE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image.hpp"
+
+/* An Image re-laid out for lensed lookups, which wander diagonally across the
+   sky: texels are grouped into tile_size x tile_size tiles stored
+   contiguously, and the tiles themselves are stored in Z (Morton) order so
+   neighbouring tiles in both directions tend to be close in memory.
+
+   Every tile carries one extra column on the right and one extra row at the
+   bottom holding its neighbours' texels (wrapped horizontally, clamped
+   vertically), so a bilinear lookup always reads a single tile. */
+struct TiledImage {
+  static constexpr int tile_shift = 4;
+  static constexpr int tile_size = 1 << tile_shift;
+  static constexpr int padded_size = tile_size + 1;
+
+  int width{0};
+  int height{0};
+  int channels{0};
+  int tiles_x{0};
+  int tiles_y{0};
+  /* Position of tile (tx, ty), at index ty * tiles_x + tx, in Z order. */
+  std::vector<std::uint32_t> slots;
+  std::vector<unsigned char> data;
+
+  /* Re-layout IMAGE. With WRAP_X the right padding wraps to column 0 (an
+     equirectangular sky), otherwise it repeats the last column. */
+  static auto from_image(const Image& image, bool wrap_x = true)
+      -> TiledImage;
+
+  inline auto tile_bytes() const -> std::size_t {
+    return static_cast<std::size_t>(padded_size) * padded_size * channels;
+  }
+
+  /* Bytes from a texel to the one below it. The texel to its right is
+     CHANNELS bytes away. Both hold even at the image's right and bottom
+     edges, through the padding. */
+  inline auto row_stride() const -> std::size_t {
+    return static_cast<std::size_t>(padded_size) * channels;
+  }
+
+  /* Texel (X, Y), for 0 <= X < width and 0 <= Y < height. */
+  inline auto texel(int x, int y) const -> const unsigned char* {
+    const int tx = x >> tile_shift;
+    const int ty = y >> tile_shift;
+    const int lx = x & (tile_size - 1);
+    const int ly = y & (tile_size - 1);
+    return data.data() + slots[ty * tiles_x + tx] * tile_bytes() +
+           static_cast<std::size_t>(ly) * row_stride() +
+           static_cast<std::size_t>(lx) * channels;
+  }
+};
+
+#endif /* WORMHOLE_TILED_IMAGE_HPP__ */
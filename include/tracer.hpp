@@ -0,0 +1,71 @@
+#ifndef WORMHOLE_TRACER_HPP__
+#define WORMHOLE_TRACER_HPP__
+
+#include <optional>
+#include <utility>
+
+#include "vec3.hpp"
+
+/* Which side of the throat a ray ends up on. Upper is l > 0. */
+enum class Universe { Upper, Lower };
+
+/* Where a camera ray lands: a unit direction on the celestial sphere of the
+   universe it escapes to. */
+struct SkySample {
+  Vec3 direction;
+  Universe universe;
+};
+
+struct Camera {
+  /* Position (l, theta, phi). */
+  double l{6.0};
+  double theta{M_PI / 2.0};
+  double phi{0.0};
+
+  /* Look direction relative to facing the throat, in radians. */
+  double yaw{0.0};
+  double pitch{0.0};
+
+  /* Vertical field of view, in radians. */
+  double fov_y{M_PI / 3.0};
+
+  auto operator==(const Camera&) const -> bool = default;
+};
+
+/* Unit vector towards the camera's (theta, phi), its e_l. */
+auto angular_position(const Camera& camera) -> Vec3;
+
+/* Turns image coordinates into camera-sky directions for one camera and
+   image size. Image coordinates are continuous: pixel (i, j) covers
+   [i, i + 1) x [j, j + 1), so its center is (i + 0.5, j + 0.5).
+
+   Directions are expressed in the camera's local frame embedded in R^3, where
+   the unit vector towards the camera's (theta, phi) plays the role of e_l. */
+class RayGenerator {
+public:
+  RayGenerator(const Camera& camera, int width, int height);
+
+  auto direction(double x, double y) const -> Vec3;
+  /* The image coordinates DIRECTION passes through, the inverse of
+     direction, or nothing if it points behind the camera. */
+  auto image_position(Vec3 direction) const
+      -> std::optional<std::pair<double, double>>;
+
+  inline auto camera() const -> const Camera& { return camera_; }
+
+private:
+  Camera camera_;
+  Vec3 forward_;
+  Vec3 right_;
+  Vec3 up_;
+  double scale_x_;
+  double scale_y_;
+  int width_;
+  int height_;
+};
+
+/* Integrate the geodesic leaving CAMERA along DIRECTION (see RayGenerator)
+   until it escapes to one of the two universes. */
+auto trace(const Camera& camera, Vec3 direction) -> SkySample;
+
+#endif /* WORMHOLE_TRACER_HPP__ */
@@ -0,0 +1,50 @@
+#ifndef WORMHOLE_TRIPLE_BUFFER_HPP__
+#define WORMHOLE_TRIPLE_BUFFER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/* Hands the latest value from one producer thread to one consumer thread
+   without locks or waiting.
+
+   The producer fills back() and publishes it; the consumer takes the newest
+   published value into front(). A third slot in the middle holds the value
+   published last, so neither side ever touches the slot the other is using
+   and values the consumer was too slow to take are simply overwritten. */
+template <typename T>
+class TripleBuffer {
+public:
+  /* Producer: the slot to fill before publishing. */
+  inline auto back() -> T& { return slots_[back_]; }
+
+  /* Producer: make back() the newest value. The next back() is another
+     slot, holding whatever it held before. */
+  inline auto publish() -> void {
+    back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) &
+            index_mask;
+  }
+
+  /* Consumer: move front() to the newest value, if one was published since
+     the last take. Returns whether it did. */
+  inline auto take() -> bool {
+    if (!(middle_.load(std::memory_order_relaxed) & fresh)) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  /* Consumer: the value last taken. */
+  inline auto front() -> T& { return slots_[front_]; }
+
+private:
+  static constexpr std::uint8_t index_mask = 0x3;
+  /* Set in middle_ when it holds a value the consumer hasn't taken. */
+  static constexpr std::uint8_t fresh = 0x4;
+
+  std::array<T, 3> slots_{};
+  std::uint8_t back_{0};
+  std::atomic<std::uint8_t> middle_{1};
+  std::uint8_t front_{2};
+};
+
+#endif /* WORMHOLE_TRIPLE_BUFFER_HPP__ */
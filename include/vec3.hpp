@@ -0,0 +1,41 @@
+#ifndef WORMHOLE_VEC3_HPP__
+#define WORMHOLE_VEC3_HPP__
+
+#include <cmath>
+
+/* Minimal 3-vector used for directions on the camera's and the universes'
+   skies. */
+struct Vec3 {
+  double x;
+  double y;
+  double z;
+};
+
+inline auto operator+(Vec3 a, Vec3 b) -> Vec3 {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+inline auto operator-(Vec3 a, Vec3 b) -> Vec3 {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline auto operator-(Vec3 a) -> Vec3 { return {-a.x, -a.y, -a.z}; }
+
+inline auto operator*(double s, Vec3 a) -> Vec3 {
+  return {s * a.x, s * a.y, s * a.z};
+}
+
+inline auto dot(Vec3 a, Vec3 b) -> double {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline auto cross(Vec3 a, Vec3 b) -> Vec3 {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+inline auto length(Vec3 a) -> double { return std::sqrt(dot(a, a)); }
+
+inline auto normalize(Vec3 a) -> Vec3 { return (1.0 / length(a)) * a; }
+
+#endif /* WORMHOLE_VEC3_HPP__ */
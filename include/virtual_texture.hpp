@@ -0,0 +1,109 @@
+#ifndef WORMHOLE_VIRTUAL_TEXTURE_HPP__
+#define WORMHOLE_VIRTUAL_TEXTURE_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "image.hpp"
+#include "mapped_file.hpp"
+
+/* A mip-mapped sky panorama cut into tiles on disk, for skies too large to
+   decode into every render job's memory (16K-32K equirectangular images).
+
+   The file is written offline by tools/sky_tiler. At run time it is memory
+   mapped and never read up front: a lookup touching a tile makes the kernel
+   fault in just that tile's pages, and end_frame hands the least recently
+   used tiles back once the resident set exceeds its budget. Memory then
+   scales with the part of the sky a frame actually sees.
+
+   Tiles are tile_size x tile_size texels with the same one-texel right and
+   bottom padding as TiledImage (wrapped across the dateline, clamped at the
+   south pole), so a bilinear lookup reads a single tile. Each tile starts on
+   its own page so it can be evicted independently. */
+class VirtualTexture {
+public:
+  static constexpr int tile_shift = 7;
+  static constexpr int tile_size = 1 << tile_shift;
+  static constexpr int padded_size = tile_size + 1;
+
+  struct Level {
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    /* Index of the level's first tile; its tiles follow in row-major order. */
+    std::size_t first_tile;
+  };
+
+  /* Map the tile file at FILE_PATH, keeping roughly RESIDENT_BUDGET bytes of
+     tiles resident between frames. Returns nothing, with an error printed,
+     if it is missing or corrupt. */
+  static auto open(std::string_view file_path, std::size_t resident_budget)
+      -> std::optional<VirtualTexture>;
+
+  inline auto channels() const { return channels_; }
+  inline auto levels() const -> const std::vector<Level>& { return levels_; }
+
+  /* Bytes from a texel to the one below it; the texel to its right is
+     channels() bytes away, through the padding at tile edges. */
+  inline auto row_stride() const -> std::size_t {
+    return static_cast<std::size_t>(padded_size) * channels_;
+  }
+
+  /* Texel (X, Y) of LEVEL, for X and Y inside the level. Marks its tile as
+     used this frame. Safe to call from several threads at once. */
+  inline auto texel(int level, int x, int y) const -> const unsigned char* {
+    const auto& l = levels_[level];
+    const std::size_t tile = l.first_tile +
+                             static_cast<std::size_t>(y >> tile_shift) *
+                                 l.tiles_x +
+                             (x >> tile_shift);
+    /* Read before writing so tiles hot on every thread stay shared in
+       cache. */
+    auto& stamp = last_used_[tile];
+    if (stamp.load(std::memory_order_relaxed) != frame_) {
+      stamp.store(frame_, std::memory_order_relaxed);
+    }
+    return tiles_ + tile * tile_stride_ +
+           static_cast<std::size_t>(y & (tile_size - 1)) * row_stride() +
+           static_cast<std::size_t>(x & (tile_size - 1)) * channels_;
+  }
+
+  /* Close the current frame: evict the least recently used tiles until the
+     resident set fits the budget, never evicting a tile used this frame.
+     Must not run concurrently with texel. */
+  auto end_frame() -> void;
+
+  /* Tiles touched since they were last evicted, and their size in bytes. */
+  auto resident_tiles() const -> std::size_t;
+  inline auto resident_bytes() const -> std::size_t {
+    return resident_tiles() * tile_stride_;
+  }
+
+private:
+  VirtualTexture() = default;
+
+  int channels_{0};
+  std::vector<Level> levels_;
+  std::size_t tile_stride_{0};
+  std::size_t resident_budget_{0};
+
+  std::optional<MappedFile> file_;
+  const unsigned char* tiles_{nullptr};
+
+  /* Frame each tile was last used in; 0 for tiles not resident. */
+  mutable std::vector<std::atomic<std::uint32_t>> last_used_;
+  std::uint32_t frame_{1};
+};
+
+/* Cut the mip chain LEVELS (level 0 first, as build_mip_pyramid returns it)
+   into a tile file at FILE_PATH. Returns false if the file can't be
+   written. */
+auto write_virtual_texture(std::string_view file_path,
+                           const std::vector<Image>& levels) -> bool;
+
+#endif /* WORMHOLE_VIRTUAL_TEXTURE_HPP__ */
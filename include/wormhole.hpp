@@ -9,10 +9,10 @@ template <typename T> struct Position {
   T z;
 };
 
-Position<double> global_spherical_polar_basis(double dir_theta,
-                                              double dir_phi) {
+inline Position<double> global_spherical_polar_basis(double dir_theta,
+                                                     double dir_phi) {
   return {.x = std::sin(dir_theta) * std::cos(dir_phi),
-          .y = std::sin(dir_theta) * std::cos(dir_phi),
+          .y = std::sin(dir_theta) * std::sin(dir_phi),
           .z = std::cos(dir_theta)};
 }
 
@@ -47,40 +47,45 @@ public:
   double p_phi;
 };
 
-double constants_of_motion_b(Ray& ray) {
+inline double constants_of_motion_b(Ray& ray) {
   return ray.p_phi;
 }
 
-double constants_of_motion_B2(Ray& ray) {
+inline double constants_of_motion_B2(Ray& ray) {
   return ray.p_theta * ray.p_theta + ray.p_phi * ray.p_phi / (std::sin(ray.theta) * std::sin(ray.theta));
 }
 
-double constants_drdl(Ray& ray){
+inline double constants_drdl(Ray& ray){
   return (2/M_PI) * std::atan(2 * ray.l / (M_PI * parameters::M));
 }
 
-double delta_length(Ray& ray) {
+inline double delta_length(Ray& ray) {
   return ray.p_l;
 }
 
-double delta_theta(Ray& ray) {
+inline double delta_theta(Ray& ray) {
   return ray.p_theta/(parameters::radius * parameters::radius);
 }
 
-double delta_phi(Ray& ray) {
+inline double delta_phi(Ray& ray) {
   return constants_of_motion_b(ray) /(parameters::radius * parameters::radius * std::sin(ray.theta) * std::sin(ray.theta));
 }
 
-double delta_plength(Ray& ray) {
+inline double delta_plength(Ray& ray) {
   return constants_of_motion_B2(ray) * constants_of_motion_B2(ray) * constants_drdl(ray) / (parameters::radius * parameters::radius * parameters::radius);
 }
 
-double delta_ptheta(Ray& ray) {
+inline double delta_ptheta(Ray& ray) {
   return constants_of_motion_b(ray) * constants_of_motion_b(ray) * std::cos(ray.theta) / (parameters::radius * parameters::radius * std::sin(ray.theta) * std::sin(ray.theta) * std::sin(ray.theta));
 }
 
-double wormhole_radius(double length, double p /* should be a constant */) {
+inline double wormhole_radius(double length, double p /* should be a constant */) {
   return std::sqrt((p * p) + (length * length));
 }
 
+/* dr/dl of wormhole_radius. */
+inline double wormhole_drdl(double length, double p) {
+  return length / wormhole_radius(length, p);
+}
+
 #endif /* _WORMHOLE_HPP_ */
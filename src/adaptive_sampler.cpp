@@ -0,0 +1,246 @@
+#include "adaptive_sampler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "parallel.hpp"
+#include "wormhole.hpp"
+
+namespace {
+enum class State : unsigned char { Empty, Interpolated, Traced };
+
+/* The pixels of one coarse cell, including its far edges, which are shared
+   with the neighbouring cells. Every cell traces its own copy of the shared
+   edges so cells can be refined independently on different threads; only
+   the pixels a cell owns are written back to the map. */
+class Window {
+public:
+  Window(const RayGenerator& rays, const SkyMap& map, int origin_x,
+         int origin_y, int width, int height)
+      : rays_{rays},
+        map_{map},
+        origin_x_{origin_x},
+        origin_y_{origin_y},
+        width_{width},
+        samples_(static_cast<std::size_t>(width) * height),
+        state_(samples_.size(), State::Empty) {}
+
+  auto traced(int x, int y) -> const SkySample& {
+    const auto i = index(x, y);
+    if (state_[i] != State::Traced) {
+      samples_[i] = trace(rays_.camera(),
+                          rays_.direction(map_.image_x(origin_x_ + x),
+                                          map_.image_y(origin_y_ + y)));
+      state_[i] = State::Traced;
+      ++traced_count_;
+    }
+    return samples_[i];
+  }
+
+  auto fill(int x, int y, const SkySample& sample) -> void {
+    const auto i = index(x, y);
+    if (state_[i] == State::Empty) {
+      samples_[i] = sample;
+      state_[i] = State::Interpolated;
+    }
+  }
+
+  inline auto at(int x, int y) const -> const SkySample& {
+    return samples_[index(x, y)];
+  }
+  inline auto traced_count() const { return traced_count_; }
+  inline auto origin_x() const { return origin_x_; }
+  inline auto origin_y() const { return origin_y_; }
+
+private:
+  inline auto index(int x, int y) const -> std::size_t {
+    return static_cast<std::size_t>(y) * width_ + x;
+  }
+
+  const RayGenerator& rays_;
+  const SkyMap& map_;
+  int origin_x_;
+  int origin_y_;
+  int width_;
+  std::vector<SkySample> samples_;
+  std::vector<State> state_;
+  std::size_t traced_count_{0};
+};
+
+/* How finely a cell has to be refined: the error its interpolation may
+   make, and the span in pixels up to which it is interpolated from its
+   corners without probing. */
+struct CellLimits {
+  double tolerance;
+  int min_cell;
+};
+
+/* Where the camera looks at the throat, to refine cells less the farther
+   they are from it. */
+class Fovea {
+public:
+  Fovea(const AdaptiveOptions& options, const RayGenerator& rays,
+        const SkyMap& map)
+      : tolerance_{options.tolerance},
+        foveation_{options.foveation},
+        rays_{rays},
+        map_{map} {
+    const Camera& camera = rays.camera();
+    throat_ = (camera.l >= 0.0 ? -1.0 : 1.0) * angular_position(camera);
+    throat_angle_ =
+        std::asin(std::min(1.0, wormhole_radius(0.0, parameters::p) /
+                                    wormhole_radius(camera.l, parameters::p)));
+    /* The angle between neighbouring map pixels, at its largest in the
+       middle of the image. */
+    pixel_angle_ = 2.0 * std::tan(camera.fov_y / 2.0) /
+                   map.window().image_height * map.window().stride;
+  }
+
+  /* Limits for the cell of WINDOW with inclusive corners (x0, y0) and
+     (x1, y1). */
+  auto limits(const Window& window, int x0, int y0, int x1, int y1) const
+      -> CellLimits {
+    if (!foveation_) return {tolerance_, 1};
+    const Vec3 center =
+        rays_.direction(map_.image_x(window.origin_x() + (x0 + x1) / 2.0),
+                        map_.image_y(window.origin_y() + (y0 + y1) / 2.0));
+    /* The distance of the cell's nearest pixel, roughly. */
+    const double half_diagonal =
+        std::hypot(x1 - x0, y1 - y0) / 2.0 * pixel_angle_;
+    const double angle =
+        std::acos(std::clamp(dot(center, throat_), -1.0, 1.0));
+    const double distance =
+        std::max(0.0, angle - half_diagonal) / throat_angle_;
+
+    const double radius = foveation_->radius;
+    if (distance <= radius) return {tolerance_, 1};
+    const double scale = std::min(foveation_->max_tolerance_scale,
+                                  (distance / radius) * (distance / radius));
+    return {tolerance_ * scale, distance <= 2.0 * radius
+                                    ? foveation_->min_cell
+                                    : 2 * foveation_->min_cell};
+  }
+
+private:
+  double tolerance_;
+  std::optional<FoveationOptions> foveation_;
+  const RayGenerator& rays_;
+  const SkyMap& map_;
+  Vec3 throat_{};
+  double throat_angle_{0.0};
+  double pixel_angle_{0.0};
+};
+
+auto bilerp(Vec3 c00, Vec3 c10, Vec3 c01, Vec3 c11, double fx, double fy)
+    -> Vec3 {
+  const Vec3 top = (1.0 - fx) * c00 + fx * c10;
+  const Vec3 bottom = (1.0 - fx) * c01 + fx * c11;
+  return normalize((1.0 - fy) * top + fy * bottom);
+}
+
+/* Refine the cell with inclusive corners (x0, y0) and (x1, y1). */
+auto refine(Window& window, int x0, int y0, int x1, int y1,
+            const Fovea& fovea) -> void {
+  if (x1 - x0 <= 1 && y1 - y0 <= 1) {
+    window.traced(x0, y0);
+    window.traced(x1, y0);
+    window.traced(x0, y1);
+    window.traced(x1, y1);
+    return;
+  }
+
+  const auto c00 = window.traced(x0, y0);
+  const auto c10 = window.traced(x1, y0);
+  const auto c01 = window.traced(x0, y1);
+  const auto c11 = window.traced(x1, y1);
+  const int mx = (x0 + x1) / 2;
+  const int my = (y0 + y1) / 2;
+
+  const auto fx = [&](int x) {
+    return x1 == x0 ? 0.0 : static_cast<double>(x - x0) / (x1 - x0);
+  };
+  const auto fy = [&](int y) {
+    return y1 == y0 ? 0.0 : static_cast<double>(y - y0) / (y1 - y0);
+  };
+  const auto predict = [&](int x, int y) {
+    return bilerp(c00.direction, c10.direction, c01.direction, c11.direction,
+                  fx(x), fy(y));
+  };
+
+  const auto [tolerance, min_cell] = fovea.limits(window, x0, y0, x1, y1);
+  const int probes[][2] = {{mx, my}, {mx, y0}, {mx, y1}, {x0, my}, {x1, my}};
+  bool smooth = c10.universe == c00.universe &&
+                c01.universe == c00.universe &&
+                c11.universe == c00.universe;
+  const bool small = x1 - x0 <= min_cell && y1 - y0 <= min_cell;
+  for (const auto& [px, py] : probes) {
+    if (!smooth || small) break;
+    const auto& probe = window.traced(px, py);
+    smooth = probe.universe == c00.universe &&
+             length(predict(px, py) - probe.direction) <= tolerance;
+  }
+
+  if (smooth) {
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        window.fill(x, y, {predict(x, y), c00.universe});
+      }
+    }
+    return;
+  }
+
+  /* Only split axes that still have interior pixels. */
+  const bool split_x = x1 - x0 > 1;
+  const bool split_y = y1 - y0 > 1;
+  const int xs[] = {x0, split_x ? mx : x1, x1};
+  const int ys[] = {y0, split_y ? my : y1, y1};
+  for (int j = 0; j < (split_y ? 2 : 1); ++j) {
+    for (int i = 0; i < (split_x ? 2 : 1); ++i) {
+      refine(window, xs[i], ys[j], xs[i + 1], ys[j + 1], fovea);
+    }
+  }
+}
+
+/* Number of coarse cells along an axis of SIZE pixels. */
+auto cell_count(int size, int step) -> int {
+  return std::max(1, (size - 1 + step - 1) / step);
+}
+}  // namespace
+
+auto AdaptiveSampler::sample(const Camera& camera, SkyMap& map) const
+    -> AdaptiveStats {
+  const int width = map.width();
+  const int height = map.height();
+  const int step = std::max(1, options_.coarse_step);
+  const int cells_x = cell_count(width, step);
+  const int cells_y = cell_count(height, step);
+  const RayGenerator rays{camera, map.window().image_width,
+                          map.window().image_height};
+  const Fovea fovea{options_, rays, map};
+
+  std::atomic<std::size_t> traced{0};
+  parallel_for(static_cast<std::size_t>(cells_x) * cells_y, [&](auto cell) {
+    const int ox = static_cast<int>(cell % cells_x) * step;
+    const int oy = static_cast<int>(cell / cells_x) * step;
+    const int window_width = std::min(step, width - 1 - ox) + 1;
+    const int window_height = std::min(step, height - 1 - oy) + 1;
+
+    Window window{rays, map, ox, oy, window_width, window_height};
+    refine(window, 0, 0, window_width - 1, window_height - 1, fovea);
+
+    /* The last cell on each axis also owns the image's final row/column. */
+    const int owned_x = ox + step >= width - 1 ? width - ox : step;
+    const int owned_y = oy + step >= height - 1 ? height - oy : step;
+    for (int y = 0; y < owned_y; ++y) {
+      for (int x = 0; x < owned_x; ++x) {
+        map.at(ox + x, oy + y) = window.at(x, y);
+      }
+    }
+    traced += window.traced_count();
+  });
+
+  return {.traced = traced,
+          .pixels = static_cast<std::size_t>(width) * height};
+}
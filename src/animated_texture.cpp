@@ -0,0 +1,215 @@
+#include "animated_texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "gl_extensions.hpp"
+#include "texture.hpp"
+
+namespace {
+auto format_index(const std::string& pattern, std::int64_t index)
+    -> std::string {
+  const int size =
+      std::snprintf(nullptr, 0, pattern.c_str(), static_cast<int>(index));
+  std::vector<char> buffer(static_cast<std::size_t>(std::max(size, 0)) + 1);
+  std::snprintf(buffer.data(), buffer.size(), pattern.c_str(),
+                static_cast<int>(index));
+  return buffer.data();
+}
+
+/* Whether FENCE has passed, without waiting for it. */
+auto signaled(GLsync fence) -> bool {
+  const auto status =
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+}  // namespace
+
+AnimatedTexture::AnimatedTexture(std::string pattern,
+                                 AnimatedTextureOptions options)
+    : pattern_{std::move(pattern)}, options_{options} {
+  if (!std::filesystem::exists(format_index(pattern_, 0))) first_index_ = 1;
+  while (std::filesystem::exists(
+      format_index(pattern_, first_index_ + frame_count_))) {
+    ++frame_count_;
+  }
+  if (frame_count_ == 0) {
+    std::cerr << "[ERROR]: Animated texture has no frames (" << pattern_
+              << ")\n";
+    std::exit(-1);
+  }
+
+  const auto first = DecodedImage::decode(frame_path(0));
+  width_ = first.base().width;
+  height_ = first.base().height;
+  nr_channels_ = first.base().channels;
+  format_ = Texture::format_for(nr_channels_, pattern_);
+  frame_bytes_ = static_cast<std::size_t>(width_) * height_ * nr_channels_;
+
+  GLint bound_texture, bound_buffer;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+  glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &bound_buffer);
+
+  glGenTextures(1, &GLid);
+  glBindTexture(GL_TEXTURE_2D, GLid);
+  Texture::set_sampling(GL_TEXTURE_2D);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, format_, width_, height_, 0, format_,
+               GL_UNSIGNED_BYTE, first.base().data);
+
+  const auto buffers_size =
+      static_cast<GLsizeiptr>(buffer_count * frame_bytes_);
+  glGenBuffers(1, &buffers_);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_);
+  if (const auto buffer_storage = gl_extensions().buffer_storage) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    buffer_storage(GL_PIXEL_UNPACK_BUFFER, buffers_size, nullptr, flags);
+    buffer_memory_ = static_cast<unsigned char*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffers_size, flags));
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, buffers_size, nullptr,
+                 GL_STREAM_DRAW);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound_texture));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(bound_buffer));
+
+  worker_ = std::jthread{[this](std::stop_token stop) { decode_loop(stop); }};
+}
+
+AnimatedTexture::~AnimatedTexture() {
+  worker_ = {};
+  for (const auto fence : fences_) {
+    if (fence) glDeleteSync(fence);
+  }
+  if (buffer_memory_) {
+    GLint bound_buffer;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &bound_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(bound_buffer));
+  }
+  glDeleteBuffers(1, &buffers_);
+  glDeleteTextures(1, &GLid);
+}
+
+auto AnimatedTexture::frame_path(std::int64_t tick) const -> std::string {
+  return format_index(pattern_, first_index_ + tick % frame_count_);
+}
+
+auto AnimatedTexture::decode_loop(std::stop_token stop) -> void {
+  std::int64_t next = 1;
+  for (;;) {
+    {
+      std::unique_lock lock{mutex_};
+      const auto has_space = [&] {
+        return ready_.size() < static_cast<std::size_t>(
+                                   std::max(1, options_.prefetch_frames));
+      };
+      if (!space_cv_.wait(lock, stop, has_space)) return;
+      /* Playback has already moved past these. */
+      next = std::max(next, wanted_);
+      if (!options_.loop && next >= frame_count_) {
+        space_cv_.wait(lock, stop, [] { return false; });
+        return;
+      }
+    }
+
+    auto image = DecodedImage::decode(frame_path(next));
+    const auto& base = image.base();
+    if (base.width != width_ || base.height != height_ ||
+        base.channels != nr_channels_) {
+      std::cerr << "[ERROR]: Animated texture frames must match in size and "
+                   "channels ("
+                << frame_path(next) << ")\n";
+      std::exit(-1);
+    }
+
+    std::lock_guard lock{mutex_};
+    ready_.push_back({.tick = next, .image = std::move(image)});
+    ++next;
+  }
+}
+
+auto AnimatedTexture::upload(const Frame& frame) -> bool {
+  auto& fence = fences_[next_buffer_];
+  if (fence) {
+    if (!signaled(fence)) return false;
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  const auto offset = next_buffer_ * frame_bytes_;
+  if (buffer_memory_) {
+    std::memcpy(buffer_memory_ + offset, frame.image.base().data,
+                frame_bytes_);
+  } else {
+    /* The fence above already guarantees the GPU is done with the range. */
+    auto* memory = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, static_cast<GLintptr>(offset),
+        static_cast<GLsizeiptr>(frame_bytes_),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+    std::memcpy(memory, frame.image.base().data, frame_bytes_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, GLid);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, format_,
+                  GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  next_buffer_ = (next_buffer_ + 1) % buffer_count;
+  return true;
+}
+
+auto AnimatedTexture::update(double time) -> void {
+  auto tick = static_cast<std::int64_t>(
+      std::floor(std::max(0.0, time) * options_.frames_per_second));
+  if (!options_.loop) tick = std::min<std::int64_t>(tick, frame_count_ - 1);
+  if (tick <= shown_) return;
+
+  std::optional<Frame> frame;
+  {
+    std::lock_guard lock{mutex_};
+    wanted_ = tick;
+    /* The latest decoded frame that is due; older ones are skipped. */
+    while (!ready_.empty() && ready_.front().tick <= tick) {
+      frame = std::move(ready_.front());
+      ready_.pop_front();
+    }
+  }
+  space_cv_.notify_one();
+  if (!frame) return;
+
+  GLint bound_texture, bound_buffer;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+  glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &bound_buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const bool uploaded = upload(*frame);
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound_texture));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(bound_buffer));
+
+  if (!uploaded) {
+    /* Every buffer is busy; try again with this frame next update. */
+    std::lock_guard lock{mutex_};
+    ready_.push_front(std::move(*frame));
+    return;
+  }
+  dropped_ += frame->tick - shown_ - 1;
+  shown_ = frame->tick;
+}
+
+auto AnimatedTexture::bind(int texture_unit) -> void {
+  glActiveTexture(Texture::translate(texture_unit));
+  glBindTexture(GL_TEXTURE_2D, GLid);
+  texture_unit_ = texture_unit;
+}
@@ -0,0 +1,209 @@
+#include "bc1.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include "parallel.hpp"
+
+namespace {
+constexpr int block_texels = 16;
+constexpr std::size_t bc1_block_bytes = 8;
+
+using Color = std::array<float, 3>;
+
+/* Pack a [0, 255] color to 5:6:5. */
+auto to_565(const Color& c) -> std::uint16_t {
+  const auto quantize = [](float v, int max) {
+    return static_cast<int>(
+        std::clamp(std::round(v * max / 255.0f), 0.0f, float(max)));
+  };
+  return static_cast<std::uint16_t>((quantize(c[0], 31) << 11) |
+                                    (quantize(c[1], 63) << 5) |
+                                    quantize(c[2], 31));
+}
+
+auto from_565(std::uint16_t v) -> Color {
+  const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+  return {static_cast<float>((r << 3) | (r >> 2)),
+          static_cast<float>((g << 2) | (g >> 4)),
+          static_cast<float>((b << 3) | (b >> 2))};
+}
+
+auto distance2(const Color& a, const Color& b) -> float {
+  const float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+  return dr * dr + dg * dg + db * db;
+}
+
+struct Encoded {
+  std::uint16_t c0;
+  std::uint16_t c1;
+  std::uint32_t indices;
+  float error;
+};
+
+/* Pick the closest of the four palette colors for every texel. Needs
+   C0 > C1 for the four-color palette. */
+auto assign(const std::array<Color, block_texels>& texels, std::uint16_t c0,
+            std::uint16_t c1) -> Encoded {
+  const Color e0 = from_565(c0), e1 = from_565(c1);
+  std::array<Color, 4> palette{e0, e1, Color{}, Color{}};
+  for (int k = 0; k < 3; ++k) {
+    palette[2][k] = (2 * e0[k] + e1[k]) / 3.0f;
+    palette[3][k] = (e0[k] + 2 * e1[k]) / 3.0f;
+  }
+  Encoded out{.c0 = c0, .c1 = c1, .indices = 0, .error = 0.0f};
+  for (int i = 0; i < block_texels; ++i) {
+    int best = 0;
+    float best_error = distance2(texels[i], palette[0]);
+    for (int p = 1; p < 4; ++p) {
+      const float error = distance2(texels[i], palette[p]);
+      if (error < best_error) {
+        best = p;
+        best_error = error;
+      }
+    }
+    out.indices |= static_cast<std::uint32_t>(best) << (2 * i);
+    out.error += best_error;
+  }
+  return out;
+}
+
+/* Quantize the endpoints and index the block with them, ordering them for
+   the four-color mode. */
+auto encode_endpoints(const std::array<Color, block_texels>& texels,
+                      const Color& a, const Color& b) -> Encoded {
+  auto c0 = to_565(a), c1 = to_565(b);
+  if (c0 < c1) std::swap(c0, c1);
+  /* Equal endpoints would select the three-color mode; all texels then
+     use index 0, which is the same color in either mode. */
+  if (c0 == c1) {
+    return {.c0 = c0,
+            .c1 = c1,
+            .indices = 0,
+            .error = assign(texels, c0, c1).error};
+  }
+  return assign(texels, c0, c1);
+}
+
+/* Endpoints minimizing the squared error for the weights ENCODED's
+   indices give each texel, if the system isn't singular. */
+auto refine(const std::array<Color, block_texels>& texels,
+            const Encoded& encoded) -> std::optional<std::array<Color, 2>> {
+  constexpr float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+  float aa = 0, ab = 0, bb = 0;
+  Color ax{}, bx{};
+  for (int i = 0; i < block_texels; ++i) {
+    const float w = weights[(encoded.indices >> (2 * i)) & 3];
+    const float v = 1.0f - w;
+    aa += w * w;
+    ab += w * v;
+    bb += v * v;
+    for (int k = 0; k < 3; ++k) {
+      ax[k] += w * texels[i][k];
+      bx[k] += v * texels[i][k];
+    }
+  }
+  const float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f) return std::nullopt;
+  std::array<Color, 2> endpoints{};
+  for (int k = 0; k < 3; ++k) {
+    endpoints[0][k] = (ax[k] * bb - bx[k] * ab) / det;
+    endpoints[1][k] = (bx[k] * aa - ax[k] * ab) / det;
+  }
+  return endpoints;
+}
+
+auto encode_block(const std::array<Color, block_texels>& texels) -> Encoded {
+  Color mean{};
+  for (const auto& t : texels) {
+    for (int k = 0; k < 3; ++k) mean[k] += t[k] / block_texels;
+  }
+  float cov[6] = {};
+  for (const auto& t : texels) {
+    const float r = t[0] - mean[0], g = t[1] - mean[1], b = t[2] - mean[2];
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  }
+  /* Principal axis by power iteration, starting from the luminance axis. */
+  Color axis{0.3f, 0.6f, 0.1f};
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    const Color next{
+        cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+        cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+        cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+    const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+                                   next[2] * next[2]);
+    if (length < 1e-6f) break;
+    for (int k = 0; k < 3; ++k) axis[k] = next[k] / length;
+  }
+
+  float lo = 0.0f, hi = 0.0f;
+  for (const auto& t : texels) {
+    const float d = (t[0] - mean[0]) * axis[0] + (t[1] - mean[1]) * axis[1] +
+                    (t[2] - mean[2]) * axis[2];
+    lo = std::min(lo, d);
+    hi = std::max(hi, d);
+  }
+  Color a, b;
+  for (int k = 0; k < 3; ++k) {
+    a[k] = mean[k] + axis[k] * hi;
+    b[k] = mean[k] + axis[k] * lo;
+  }
+  auto best = encode_endpoints(texels, a, b);
+  if (best.c0 == best.c1) return best;
+
+  if (const auto endpoints = refine(texels, best)) {
+    const auto refined =
+        encode_endpoints(texels, (*endpoints)[0], (*endpoints)[1]);
+    if (refined.error < best.error) best = refined;
+  }
+  return best;
+}
+}  // namespace
+
+auto encode_bc1(const Image& image) -> std::vector<unsigned char> {
+  const int blocks_x = (image.width + 3) / 4;
+  const int blocks_y = (image.height + 3) / 4;
+  std::vector<unsigned char> out(static_cast<std::size_t>(blocks_x) *
+                                 blocks_y * bc1_block_bytes);
+
+  parallel_for(static_cast<std::size_t>(blocks_y), [&](std::size_t by) {
+    std::array<Color, block_texels> texels;
+    for (int bx = 0; bx < blocks_x; ++bx) {
+      /* Blocks hanging over the edge repeat the last row and column. */
+      for (int i = 0; i < block_texels; ++i) {
+        const int x = std::min(bx * 4 + i % 4, image.width - 1);
+        const int y =
+            std::min(static_cast<int>(by) * 4 + i / 4, image.height - 1);
+        const unsigned char* texel = image.texel(x, y);
+        for (int k = 0; k < 3; ++k) {
+          texels[i][k] = texel[image.channels >= 3 ? k : 0];
+        }
+      }
+      const auto block = encode_block(texels);
+      unsigned char* dst =
+          out.data() +
+          (by * static_cast<std::size_t>(blocks_x) + bx) * bc1_block_bytes;
+      /* Little-endian, as the format specifies. */
+      const unsigned char bytes[bc1_block_bytes] = {
+          static_cast<unsigned char>(block.c0 & 0xff),
+          static_cast<unsigned char>(block.c0 >> 8),
+          static_cast<unsigned char>(block.c1 & 0xff),
+          static_cast<unsigned char>(block.c1 >> 8),
+          static_cast<unsigned char>(block.indices & 0xff),
+          static_cast<unsigned char>((block.indices >> 8) & 0xff),
+          static_cast<unsigned char>((block.indices >> 16) & 0xff),
+          static_cast<unsigned char>(block.indices >> 24)};
+      std::memcpy(dst, bytes, bc1_block_bytes);
+    }
+  });
+  return out;
+}
@@ -0,0 +1,26 @@
+#include "content_hash.hpp"
+
+#include <bit>
+#include <cstring>
+
+auto content_hash(const unsigned char* data, std::size_t size)
+    -> std::uint64_t {
+  constexpr std::uint64_t prime1 = 0x9e3779b185ebca87;
+  constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+  std::uint64_t lanes[4] = {prime1, prime2, ~prime1, ~prime2};
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int k = 0; k < 4; ++k) {
+      std::uint64_t word;
+      std::memcpy(&word, data + i + 8 * k, sizeof(word));
+      lanes[k] = std::rotl(lanes[k] + word * prime2, 31) * prime1;
+    }
+  }
+  std::uint64_t h = size * prime1;
+  for (const auto lane : lanes) h = std::rotl(h ^ lane, 27) * prime1;
+  for (; i < size; ++i) h = (h ^ data[i]) * prime2;
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  return h;
+}
@@ -0,0 +1,133 @@
+#include "cubemap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "color.hpp"
+#include "parallel.hpp"
+
+namespace {
+/* For each face: the major axis it faces, and the axes s and t grow along,
+   following the OpenGL cube map selection table. */
+struct FaceAxes {
+  Vec3 major;
+  Vec3 s;
+  Vec3 t;
+};
+
+constexpr FaceAxes face_axes[cube_faces] = {
+    {{1, 0, 0}, {0, 0, -1}, {0, -1, 0}},  /* +X */
+    {{-1, 0, 0}, {0, 0, 1}, {0, -1, 0}},  /* -X */
+    {{0, 1, 0}, {1, 0, 0}, {0, 0, 1}},    /* +Y */
+    {{0, -1, 0}, {1, 0, 0}, {0, 0, -1}},  /* -Y */
+    {{0, 0, 1}, {1, 0, 0}, {0, -1, 0}},   /* +Z */
+    {{0, 0, -1}, {-1, 0, 0}, {0, -1, 0}}, /* -Z */
+};
+
+/* Bilinear lookup of an equirectangular panorama, in linear. */
+auto panorama_bilinear(const unsigned char* pixels, int width, int height,
+                       int channels, SkyUV uv) -> Color {
+  const double x = uv.u * width - 0.5;
+  const double y = std::clamp(uv.v * height - 0.5, 0.0,
+                              static_cast<double>(height - 1));
+  const double fx = std::floor(x);
+  const double fy = std::floor(y);
+  const float tx = static_cast<float>(x - fx);
+  const float ty = static_cast<float>(y - fy);
+
+  const auto wrap = [&](long i) {
+    return static_cast<int>(((i % width) + width) % width);
+  };
+  const int x0 = wrap(static_cast<long>(fx));
+  const int x1 = wrap(static_cast<long>(fx) + 1);
+  const int y0 = static_cast<int>(fy);
+  const int y1 = std::min(y0 + 1, height - 1);
+  const auto texel = [&](int tx_, int ty_) {
+    return decode_texel(
+        pixels + (static_cast<std::size_t>(ty_) * width + tx_) * channels,
+        channels);
+  };
+  return lerp(lerp(texel(x0, y0), texel(x1, y0), tx),
+              lerp(texel(x0, y1), texel(x1, y1), tx), ty);
+}
+}  // namespace
+
+auto cube_face_uv(Vec3 direction) -> CubeUV {
+  const double ax = std::abs(direction.x);
+  const double ay = std::abs(direction.y);
+  const double az = std::abs(direction.z);
+  int face;
+  if (ax >= ay && ax >= az) {
+    face = direction.x >= 0.0 ? 0 : 1;
+  } else if (ay >= az) {
+    face = direction.y >= 0.0 ? 2 : 3;
+  } else {
+    face = direction.z >= 0.0 ? 4 : 5;
+  }
+  const auto& axes = face_axes[face];
+  const double inv_major = 1.0 / dot(direction, axes.major);
+  return {.face = face,
+          .s = 0.5 * (dot(direction, axes.s) * inv_major + 1.0),
+          .t = 0.5 * (dot(direction, axes.t) * inv_major + 1.0)};
+}
+
+auto cube_face_direction(int face, double s, double t) -> Vec3 {
+  const auto& axes = face_axes[face];
+  return axes.major + (2.0 * s - 1.0) * axes.s + (2.0 * t - 1.0) * axes.t;
+}
+
+auto cube_face_footprint(Vec3 direction, int face,
+                         const SkyFootprint& footprint) -> UVFootprint {
+  /* s = (S / M + 1) / 2, so ds = (dS M - S dM) / (2 M^2); likewise t. */
+  const auto& axes = face_axes[face];
+  const double m = dot(direction, axes.major);
+  const double s = dot(direction, axes.s);
+  const double t = dot(direction, axes.t);
+  const double scale = 0.5 / (m * m);
+  const auto ds = [&](Vec3 d) {
+    return scale * (dot(d, axes.s) * m - s * dot(d, axes.major));
+  };
+  const auto dt = [&](Vec3 d) {
+    return scale * (dot(d, axes.t) * m - t * dot(d, axes.major));
+  };
+  return {.du_dx = ds(footprint.dx),
+          .dv_dx = dt(footprint.dx),
+          .du_dy = ds(footprint.dy),
+          .dv_dy = dt(footprint.dy)};
+}
+
+auto equirect_to_cubemap(const unsigned char* pixels, int width, int height,
+                         int channels, int face_size)
+    -> std::array<Image, cube_faces> {
+  std::array<Image, cube_faces> faces;
+  for (auto& face : faces) {
+    face = {.width = face_size,
+            .height = face_size,
+            .channels = channels,
+            .data = std::vector<unsigned char>(
+                static_cast<std::size_t>(face_size) * face_size * channels)};
+  }
+
+  constexpr double offsets[] = {0.25, 0.75};
+  parallel_for(cube_faces * face_size, [&](auto row) {
+    const int face = static_cast<int>(row) / face_size;
+    const int y = static_cast<int>(row) % face_size;
+    unsigned char* out = faces[face].data.data() +
+                         static_cast<std::size_t>(y) * face_size * channels;
+    for (int x = 0; x < face_size; ++x, out += channels) {
+      Color sum{0.0f, 0.0f, 0.0f, 0.0f};
+      for (const double oy : offsets) {
+        for (const double ox : offsets) {
+          const Vec3 direction = normalize(cube_face_direction(
+              face, (x + ox) / face_size, (y + oy) / face_size));
+          const auto c = panorama_bilinear(pixels, width, height, channels,
+                                           equirect_uv(direction));
+          sum = {sum.r + c.r, sum.g + c.g, sum.b + c.b, sum.a + c.a};
+        }
+      }
+      encode_texel({sum.r / 4, sum.g / 4, sum.b / 4, sum.a / 4}, channels,
+                   out);
+    }
+  });
+  return faces;
+}
@@ -0,0 +1,364 @@
+#include "decoded_image.hpp"
+
+#include <stb_image.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "content_hash.hpp"
+#include "srgb.hpp"
+
+namespace {
+constexpr char file_magic[4] = {'W', 'H', 'D', 'C'};
+constexpr std::uint32_t file_version = 1;
+/* Level 0 starts on a page so the mapping can be handed straight to
+   glTexImage2D; later levels only need to be aligned for SIMD loads. */
+constexpr std::size_t data_alignment = 4096;
+constexpr std::size_t level_alignment = 64;
+
+struct FileHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t channels;
+  std::uint32_t level_count;
+  /* 0 for a single level, otherwise the MipFilter plus one. */
+  std::uint32_t mips;
+  std::uint32_t reserved;
+  std::uint64_t source_size;
+  std::int64_t source_time;
+  std::uint64_t source_hash;
+};
+
+struct FileLevel {
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint64_t offset;
+};
+
+/* What the sidecar must match to stand in for the source. */
+struct Source {
+  std::string path;
+  std::uint64_t size;
+  std::int64_t time;
+};
+
+auto round_up(std::size_t n, std::size_t multiple) -> std::size_t {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+auto mips_tag(std::optional<MipFilter> mips) -> std::uint32_t {
+  return mips ? static_cast<std::uint32_t>(*mips) + 1 : 0;
+}
+
+auto source_hash(const Source& source) -> std::optional<std::uint64_t> {
+  const auto file = MappedFile::open(source.path);
+  if (!file) return std::nullopt;
+  return content_hash(file->data(), file->size());
+}
+
+/* Record the modification time of SOURCE in the sidecar at SIDECAR_PATH,
+   once its contents are known to match, so later loads don't hash the
+   source again. Only the time field is written; readers that see the old
+   one just hash once more. */
+auto touch_sidecar(const std::string& sidecar_path, const Source& source)
+    -> void {
+  std::fstream file{sidecar_path,
+                    std::ios::binary | std::ios::in | std::ios::out};
+  file.seekp(offsetof(FileHeader, source_time));
+  file.write(reinterpret_cast<const char*>(&source.time),
+             sizeof(source.time));
+}
+
+/* The levels stored in FILE, mapped from SIDECAR_PATH, if it is a sidecar
+   for SOURCE with the requested MIPS. */
+auto read_sidecar(const MappedFile& file, const std::string& sidecar_path,
+                  const Source& source, std::optional<MipFilter> mips)
+    -> std::optional<std::vector<ImageView>> {
+  FileHeader header;
+  if (file.size() < sizeof(header)) return std::nullopt;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+      header.version != file_version || header.level_count == 0 ||
+      header.channels < 1 || header.channels > 4 ||
+      (mips && header.mips != mips_tag(mips)) ||
+      sizeof(header) + header.level_count * sizeof(FileLevel) > file.size()) {
+    return std::nullopt;
+  }
+
+  /* A sidecar with mips also serves loads that only want level 0. */
+  const std::uint32_t count = mips ? header.level_count : 1;
+  std::vector<ImageView> levels;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    FileLevel level;
+    std::memcpy(&level,
+                file.data() + sizeof(header) + i * sizeof(FileLevel),
+                sizeof(level));
+    /* Widths and heights fit an int, so a row's bytes can't overflow;
+       the whole level is checked by division. */
+    if (level.width == 0 || level.height == 0 || level.width > INT_MAX ||
+        level.height > INT_MAX || level.offset > file.size()) {
+      return std::nullopt;
+    }
+    const auto row_bytes =
+        static_cast<std::uint64_t>(level.width) * header.channels;
+    if (row_bytes > (file.size() - level.offset) / level.height) {
+      return std::nullopt;
+    }
+    levels.push_back({.width = static_cast<int>(level.width),
+                      .height = static_cast<int>(level.height),
+                      .channels = static_cast<int>(header.channels),
+                      .data = file.data() + level.offset});
+  }
+
+  /* A touched or copied source keeps the sidecar if its contents match. */
+  if (header.source_size != source.size ||
+      header.source_time != source.time) {
+    if (header.source_size != source.size ||
+        source_hash(source) != header.source_hash) {
+      return std::nullopt;
+    }
+    touch_sidecar(sidecar_path, source);
+  }
+  return levels;
+}
+
+/* Write LEVELS as the sidecar of SOURCE, whose contents hash to HASH.
+   Goes through a temporary file so concurrent render jobs never map a
+   half-written sidecar. Temporary names carry the process id and a
+   per-process count, since loads run on several threads too. */
+auto write_sidecar(const std::string& sidecar_path, const Source& source,
+                   std::uint64_t hash, const std::vector<Image>& levels,
+                   std::optional<MipFilter> mips) -> void {
+  FileHeader header{};
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.channels = static_cast<std::uint32_t>(levels.front().channels);
+  header.level_count = static_cast<std::uint32_t>(levels.size());
+  header.mips = mips_tag(mips);
+  header.source_size = source.size;
+  header.source_time = source.time;
+  header.source_hash = hash;
+
+  std::vector<FileLevel> table;
+  std::size_t offset = round_up(
+      sizeof(header) + levels.size() * sizeof(FileLevel), data_alignment);
+  for (const auto& level : levels) {
+    table.push_back({.width = static_cast<std::uint32_t>(level.width),
+                     .height = static_cast<std::uint32_t>(level.height),
+                     .offset = offset});
+    offset = round_up(offset + level.data.size(), level_alignment);
+  }
+
+  static std::atomic<unsigned> next_temp{0};
+  const auto temp_path = sidecar_path + "." + std::to_string(::getpid()) +
+                         "." + std::to_string(next_temp++);
+  {
+    std::ofstream out{temp_path, std::ios::binary};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()),
+              static_cast<std::streamsize>(table.size() * sizeof(FileLevel)));
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+      out.seekp(static_cast<std::streamoff>(table[i].offset));
+      out.write(reinterpret_cast<const char*>(levels[i].data.data()),
+                static_cast<std::streamsize>(levels[i].data.size()));
+    }
+    if (out) {
+      out.close();
+      std::error_code error;
+      std::filesystem::rename(temp_path, sidecar_path, error);
+      if (!error) return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::remove(temp_path, error);
+}
+/* BASE shrunk by an integer factor until its longer side fits in
+   MAX_SIZE, averaging each block of texels in linear space. One pass over
+   BASE, so it costs little next to the decode it follows. */
+auto thumbnail(const ImageView& base, int max_size) -> Image {
+  const int factor =
+      (std::max(base.width, base.height) + max_size - 1) / max_size;
+  const int c = base.channels;
+  Image thumb{.width = (base.width + factor - 1) / factor,
+              .height = (base.height + factor - 1) / factor,
+              .channels = c,
+              .data = {}};
+  thumb.data.resize(static_cast<std::size_t>(thumb.width) * thumb.height * c);
+
+  std::vector<float> sums(static_cast<std::size_t>(thumb.width) * c);
+  std::vector<int> counts(thumb.width);
+  for (int ty = 0; ty < thumb.height; ++ty) {
+    std::fill(sums.begin(), sums.end(), 0.0f);
+    std::fill(counts.begin(), counts.end(), 0);
+    const int y1 = std::min(base.height, (ty + 1) * factor);
+    for (int y = ty * factor; y < y1; ++y) {
+      const unsigned char* row =
+          base.data + static_cast<std::size_t>(y) * base.width * c;
+      for (int x = 0; x < base.width; ++x) {
+        float* sum = &sums[static_cast<std::size_t>(x / factor) * c];
+        for (int k = 0; k < c; ++k) {
+          sum[k] += is_alpha_channel(k, c) ? alpha_to_float(row[x * c + k])
+                                           : srgb_to_linear(row[x * c + k]);
+        }
+        ++counts[x / factor];
+      }
+    }
+    unsigned char* out =
+        thumb.data.data() + static_cast<std::size_t>(ty) * thumb.width * c;
+    for (int tx = 0; tx < thumb.width; ++tx) {
+      const float inv = 1.0f / static_cast<float>(counts[tx]);
+      for (int k = 0; k < c; ++k) {
+        const float mean = sums[static_cast<std::size_t>(tx) * c + k] * inv;
+        out[tx * c + k] = is_alpha_channel(k, c) ? float_to_alpha(mean)
+                                                 : linear_to_srgb(mean);
+      }
+    }
+  }
+  return thumb;
+}
+
+auto proxy_path(const Source& source) -> std::string {
+  return source.path + ".proxy";
+}
+
+/* Write the thumbnail load_proxy serves for SOURCE. */
+auto write_proxy(const Source& source, std::uint64_t hash,
+                 const ImageView& base) -> void {
+  write_sidecar(proxy_path(source), source, hash,
+                {thumbnail(base, DecodedImage::proxy_size)}, std::nullopt);
+}
+
+/* Decode FILE_PATH with stb_image; nothing, with an error printed, if it
+   can't be. */
+auto stb_decode(std::string_view file_path) -> std::optional<Image> {
+  const std::string path{file_path};
+  int width, height, channels;
+  unsigned char* data =
+      stbi_load(path.c_str(), &width, &height, &channels, 0);
+  if (!data) {
+    std::cerr << "Failed to load texture image (" << file_path << ")\n";
+    return std::nullopt;
+  }
+  Image image{.width = width,
+              .height = height,
+              .channels = channels,
+              .data = {data, data + static_cast<std::size_t>(width) * height *
+                                        channels}};
+  stbi_image_free(data);
+  return image;
+}
+
+auto source_of(std::string_view file_path) -> Source {
+  return {.path = std::string{file_path},
+          .size = std::filesystem::file_size(file_path),
+          .time = std::filesystem::last_write_time(file_path)
+                      .time_since_epoch()
+                      .count()};
+}
+}  // namespace
+
+auto DecodedImage::load(std::string_view file_path,
+                        std::optional<MipFilter> mips) -> DecodedImage {
+  auto image = try_load(file_path, mips);
+  if (!image) std::exit(-1);
+  return std::move(*image);
+}
+
+auto DecodedImage::try_load(std::string_view file_path,
+                            std::optional<MipFilter> mips)
+    -> std::optional<DecodedImage> {
+  if (!std::filesystem::exists(file_path)) {
+    std::cerr << "[ERROR]: Texture image does not exist (" << file_path
+              << ")\n";
+    return std::nullopt;
+  }
+  const auto source = source_of(file_path);
+  const auto sidecar_path = source.path + ".decoded";
+
+  DecodedImage image{};
+  if (auto file = MappedFile::open(sidecar_path)) {
+    if (auto levels = read_sidecar(*file, sidecar_path, source, mips)) {
+      image.levels_ = std::move(*levels);
+      image.file_ = std::move(file);
+      /* Sidecars written before proxies existed. */
+      if (!std::filesystem::exists(proxy_path(source))) {
+        if (const auto hash = source_hash(source)) {
+          write_proxy(source, *hash, image.base());
+        }
+      }
+      return image;
+    }
+  }
+
+  auto base = stb_decode(file_path);
+  if (!base) return std::nullopt;
+  if (mips) {
+    image.images_ = build_mip_pyramid(std::move(*base), *mips);
+  } else {
+    image.images_.push_back(std::move(*base));
+  }
+  for (const auto& level : image.images_) {
+    image.levels_.push_back({.width = level.width,
+                             .height = level.height,
+                             .channels = level.channels,
+                             .data = level.data.data()});
+  }
+  if (const auto hash = source_hash(source)) {
+    write_sidecar(sidecar_path, source, *hash, image.images_, mips);
+    write_proxy(source, *hash, image.base());
+  }
+  return image;
+}
+
+auto DecodedImage::decode(std::string_view file_path) -> DecodedImage {
+  auto decoded = stb_decode(file_path);
+  if (!decoded) std::exit(-1);
+  DecodedImage image{};
+  image.images_.push_back(std::move(*decoded));
+  const auto& base = image.images_.front();
+  image.levels_.push_back({.width = base.width,
+                           .height = base.height,
+                           .channels = base.channels,
+                           .data = base.data.data()});
+  return image;
+}
+
+auto DecodedImage::load_proxy(std::string_view file_path)
+    -> std::optional<DecodedImage> {
+  std::error_code error;
+  if (!std::filesystem::exists(file_path, error)) return std::nullopt;
+  const auto source = source_of(file_path);
+  const auto path = proxy_path(source);
+  auto file = MappedFile::open(path);
+  if (!file) return std::nullopt;
+  auto levels = read_sidecar(*file, path, source, std::nullopt);
+  if (!levels) return std::nullopt;
+
+  DecodedImage image{};
+  image.levels_ = std::move(*levels);
+  image.file_ = std::move(file);
+  return image;
+}
+
+auto DecodedImage::to_images() const -> std::vector<Image> {
+  if (!file_) return images_;
+  std::vector<Image> images;
+  for (const auto& level : levels_) {
+    const auto size =
+        static_cast<std::size_t>(level.width) * level.height * level.channels;
+    images.push_back({.width = level.width,
+                      .height = level.height,
+                      .channels = level.channels,
+                      .data = {level.data, level.data + size}});
+  }
+  return images;
+}
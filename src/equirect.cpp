@@ -0,0 +1,26 @@
+#include "equirect.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+auto equirect_uv(Vec3 direction) -> SkyUV {
+  return {.u = 0.5 + std::atan2(direction.y, direction.x) / (2.0 * M_PI),
+          .v = std::acos(std::clamp(direction.z, -1.0, 1.0)) / M_PI};
+}
+
+auto equirect_footprint(Vec3 direction, const SkyFootprint& footprint)
+    -> UVFootprint {
+  /* Jacobians of u = atan2(y, x) / 2pi and v = acos(z) / pi. Clamped so the
+     footprint stays finite at the poles. */
+  const double rho2 =
+      std::max(direction.x * direction.x + direction.y * direction.y, 1e-12);
+  const double sin_theta = std::sqrt(rho2);
+  const auto du = [&](Vec3 d) {
+    return (direction.x * d.y - direction.y * d.x) / (2.0 * M_PI * rho2);
+  };
+  const auto dv = [&](Vec3 d) { return -d.z / (M_PI * sin_theta); };
+  return {.du_dx = du(footprint.dx),
+          .dv_dx = dv(footprint.dx),
+          .du_dy = du(footprint.dy),
+          .dv_dy = dv(footprint.dy)};
+}
@@ -0,0 +1,162 @@
+#include "frame_timer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+/* The smallest duration the histogram tells apart, in seconds. */
+constexpr double histogram_floor = 1e-6;
+
+constexpr const char* stage_names[frame_stage_count] = {
+    "input", "compute", "upload", "draw", "swap"};
+
+auto to_seconds(std::chrono::steady_clock::duration duration) -> double {
+  return std::chrono::duration<double>(duration).count();
+}
+}  // namespace
+
+auto TimeHistogram::add(double seconds) -> void {
+  const double octaves = std::log2(std::max(seconds, histogram_floor) /
+                                   histogram_floor);
+  const int bucket = std::min(
+      bucket_count - 1, static_cast<int>(octaves * buckets_per_octave));
+  ++buckets_[bucket];
+  ++count_;
+  max_ = std::max(max_, seconds);
+}
+
+auto TimeHistogram::percentile(double q) const -> double {
+  if (count_ == 0) return 0.0;
+  const auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(std::ceil(q * count_)));
+  std::uint64_t seen = 0;
+  for (int bucket = 0; bucket < bucket_count; ++bucket) {
+    seen += buckets_[bucket];
+    if (seen >= rank) {
+      /* The bucket's upper edge, but never above what was seen. */
+      const double upper =
+          histogram_floor *
+          std::exp2(static_cast<double>(bucket + 1) / buckets_per_octave);
+      return std::min(upper, max_);
+    }
+  }
+  return max_;
+}
+
+FrameTimer::FrameTimer(FrameTimerOptions options) {
+  glGenQueries(static_cast<GLsizei>(query_count), queries_.data());
+  if (!options.csv_path.empty()) {
+    csv_.open(options.csv_path);
+    if (!csv_) {
+      std::cerr << "[ERROR]: Failed to open timing file ("
+                << options.csv_path << ")\n";
+      std::exit(-1);
+    }
+    csv_ << "frame";
+    for (const auto* name : stage_names) csv_ << ',' << name << "_ms";
+    csv_ << ",frame_ms,gpu_ms\n";
+  }
+}
+
+FrameTimer::~FrameTimer() {
+  while (!pending_.empty()) collect(true);
+  glDeleteQueries(static_cast<GLsizei>(query_count), queries_.data());
+}
+
+auto FrameTimer::begin_frame() -> void {
+  current_ = {};
+  in_frame_ = true;
+  frame_start_ = stage_start_ = Clock::now();
+}
+
+auto FrameTimer::end_stage(FrameStage stage) -> void {
+  const auto now = Clock::now();
+  current_.stages[static_cast<int>(stage)] += to_seconds(now - stage_start_);
+  stage_start_ = now;
+}
+
+auto FrameTimer::begin_gpu() -> void {
+  /* Every query is still in flight: only now wait for the oldest. */
+  while (pending_.size() >= query_count) collect(true);
+  current_.query = static_cast<int>(next_query_);
+  next_query_ = (next_query_ + 1) % query_count;
+  glBeginQuery(GL_TIME_ELAPSED, queries_[current_.query]);
+}
+
+auto FrameTimer::end_gpu() -> void { glEndQuery(GL_TIME_ELAPSED); }
+
+auto FrameTimer::end_frame() -> void {
+  if (!in_frame_) return;
+  in_frame_ = false;
+  current_.total = to_seconds(Clock::now() - frame_start_);
+  if (current_.query < 0) {
+    record(current_, 0.0);
+  } else {
+    pending_.push_back(current_);
+  }
+  collect(false);
+}
+
+auto FrameTimer::collect(bool wait) -> void {
+  while (!pending_.empty()) {
+    const auto query = queries_[pending_.front().query];
+    if (!wait) {
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) return;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    record(pending_.front(), nanoseconds * 1e-9);
+    pending_.pop_front();
+    if (wait) return;
+  }
+}
+
+auto FrameTimer::record(const Frame& frame, double gpu_seconds) -> void {
+  for (int stage = 0; stage < frame_stage_count; ++stage) {
+    stages_[stage].add(frame.stages[stage]);
+  }
+  frame_.add(frame.total);
+  if (frame.query >= 0) gpu_.add(gpu_seconds);
+
+  if (csv_.is_open()) {
+    csv_ << frames_;
+    for (const double seconds : frame.stages) csv_ << ',' << seconds * 1e3;
+    csv_ << ',' << frame.total * 1e3 << ',' << gpu_seconds * 1e3 << '\n';
+  }
+  ++frames_;
+}
+
+auto FrameTimer::report(std::ostream& out) const -> void {
+  const auto line = [&](const char* name, const TimeHistogram& histogram) {
+    out << std::left << std::setw(8) << name << std::right << std::fixed
+        << std::setprecision(3);
+    for (const double q : {0.5, 0.9, 0.99}) {
+      out << std::setw(10) << histogram.percentile(q) * 1e3;
+    }
+    out << std::setw(10) << histogram.max() * 1e3 << '\n';
+  };
+  out << "Frame timings over " << frame_.count()
+      << " frames, in ms:\n"
+         "stage          p50       p90       p99       max\n";
+  for (int stage = 0; stage < frame_stage_count; ++stage) {
+    line(stage_names[stage], stages_[stage]);
+  }
+  line("frame", frame_);
+  line("gpu", gpu_);
+}
+
+auto FrameTimer::summary() const -> std::string {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << "frame p50 "
+      << frame_.percentile(0.5) * 1e3 << " ms, p99 "
+      << frame_.percentile(0.99) * 1e3 << " ms; gpu p50 "
+      << gpu_.percentile(0.5) * 1e3 << " ms, p99 "
+      << gpu_.percentile(0.99) * 1e3 << " ms";
+  return out.str();
+}
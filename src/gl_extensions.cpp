@@ -0,0 +1,73 @@
+#include "gl_extensions.hpp"
+
+#include <cstring>
+
+namespace {
+GLExtensions extensions{};
+
+auto has_extension(const char* name) -> bool {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const auto* extension =
+        reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && std::strcmp(extension, name) == 0) return true;
+  }
+  return false;
+}
+
+/* Whether the context is at least MAJOR.MINOR. */
+auto has_version(int major, int minor) -> bool {
+  GLint context_major = 0, context_minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+  glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+  return context_major > major ||
+         (context_major == major && context_minor >= minor);
+}
+
+template <typename Proc>
+auto load_proc(GLADloadfunc load, Proc& proc, const char* name) -> void {
+  proc = reinterpret_cast<Proc>(load(name));
+}
+}  // namespace
+
+auto load_gl_extensions(GLADloadfunc load) -> void {
+  extensions = {};
+  if (has_version(4, 4) || has_extension("GL_ARB_buffer_storage")) {
+    load_proc(load, extensions.buffer_storage, "glBufferStorage");
+  }
+  if (has_extension("GL_ARB_bindless_texture")) {
+    load_proc(load, extensions.get_texture_handle, "glGetTextureHandleARB");
+    load_proc(load, extensions.make_texture_handle_resident,
+              "glMakeTextureHandleResidentARB");
+    load_proc(load, extensions.uniform_handle, "glUniformHandleui64ARB");
+  }
+  if (has_version(4, 1) || has_extension("GL_ARB_get_program_binary")) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats > 0) {
+      load_proc(load, extensions.get_program_binary, "glGetProgramBinary");
+      load_proc(load, extensions.program_binary, "glProgramBinary");
+      load_proc(load, extensions.program_parameteri, "glProgramParameteri");
+    }
+  }
+  if (has_extension("GL_KHR_parallel_shader_compile")) {
+    load_proc(load, extensions.max_shader_compiler_threads,
+              "glMaxShaderCompilerThreadsKHR");
+  } else if (has_extension("GL_ARB_parallel_shader_compile")) {
+    load_proc(load, extensions.max_shader_compiler_threads,
+              "glMaxShaderCompilerThreadsARB");
+  }
+  /* As many compiler threads as the driver sees fit, rather than its
+     default, which may be none. */
+  if (extensions.max_shader_compiler_threads) {
+    extensions.max_shader_compiler_threads(0xFFFFFFFF);
+  }
+  extensions.s3tc = has_extension("GL_EXT_texture_compression_s3tc");
+  extensions.bptc =
+      has_version(4, 2) || has_extension("GL_ARB_texture_compression_bptc");
+  extensions.etc2 =
+      has_version(4, 3) || has_extension("GL_ARB_ES3_compatibility");
+}
+
+auto gl_extensions() -> const GLExtensions& { return extensions; }
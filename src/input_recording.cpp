@@ -0,0 +1,90 @@
+#include "input_recording.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace {
+/* The first line of a recording, naming its format. */
+constexpr std::string_view header = "wormhole-input 1";
+}  // namespace
+
+auto InputRecorder::create(std::string_view file_path)
+    -> std::optional<InputRecorder> {
+  std::ofstream out{std::string{file_path}};
+  if (!out) return std::nullopt;
+  out << header << '\n'
+      << "# time along around yaw pitch l theta phi camera_yaw camera_pitch "
+         "fov_y width height\n"
+      << std::setprecision(std::numeric_limits<double>::max_digits10);
+  return InputRecorder{std::move(out)};
+}
+
+InputRecorder::InputRecorder(std::ofstream out) : out_{std::move(out)} {}
+
+auto InputRecorder::record(const InputSample& sample) -> void {
+  const auto& keys = sample.keys;
+  const auto& camera = sample.camera;
+  out_ << sample.time << ' ' << keys.along << ' ' << keys.around << ' '
+       << keys.yaw << ' ' << keys.pitch << ' ' << camera.l << ' '
+       << camera.theta << ' ' << camera.phi << ' ' << camera.yaw << ' '
+       << camera.pitch << ' ' << camera.fov_y << ' ' << sample.width << ' '
+       << sample.height << '\n';
+}
+
+auto InputReplay::from_file(std::string_view file_path)
+    -> std::optional<InputReplay> {
+  std::ifstream in{std::string{file_path}};
+  if (!in) {
+    std::cerr << "[ERROR]: Failed to open input recording " << file_path
+              << '\n';
+    return std::nullopt;
+  }
+
+  std::string line;
+  if (!std::getline(in, line) || line != header) {
+    std::cerr << "[ERROR]: Not an input recording: " << file_path << '\n';
+    return std::nullopt;
+  }
+
+  std::vector<InputSample> samples;
+  for (int number = 2; std::getline(in, line); ++number) {
+    if (line.empty() || line.front() == '#') continue;
+    std::istringstream fields{line};
+    InputSample sample{};
+    auto& keys = sample.keys;
+    auto& camera = sample.camera;
+    fields >> sample.time >> keys.along >> keys.around >> keys.yaw >>
+        keys.pitch >> camera.l >> camera.theta >> camera.phi >> camera.yaw >>
+        camera.pitch >> camera.fov_y >> sample.width >> sample.height;
+    if (!fields || (!samples.empty() && sample.time < samples.back().time)) {
+      std::cerr << "[ERROR]: Bad input recording " << file_path << ", line "
+                << number << '\n';
+      return std::nullopt;
+    }
+    samples.push_back(sample);
+  }
+  if (samples.empty()) {
+    std::cerr << "[ERROR]: Empty input recording " << file_path << '\n';
+    return std::nullopt;
+  }
+  return InputReplay{std::move(samples)};
+}
+
+InputReplay::InputReplay(std::vector<InputSample> samples)
+    : samples_{std::move(samples)} {}
+
+auto InputReplay::advance(double time) -> bool {
+  if (current_ + 1 == samples_.size() || samples_[current_ + 1].time > time) {
+    return false;
+  }
+  ++current_;
+  return true;
+}
+
+auto InputReplay::next_time() const -> std::optional<double> {
+  if (finished()) return std::nullopt;
+  return samples_[current_ + 1].time;
+}
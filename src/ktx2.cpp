@@ -0,0 +1,206 @@
+#include "ktx2.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+constexpr unsigned char file_identifier[12] = {
+    0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+struct FileHeader {
+  unsigned char identifier[12];
+  std::uint32_t vk_format;
+  std::uint32_t type_size;
+  std::uint32_t pixel_width;
+  std::uint32_t pixel_height;
+  std::uint32_t pixel_depth;
+  std::uint32_t layer_count;
+  std::uint32_t face_count;
+  std::uint32_t level_count;
+  std::uint32_t supercompression_scheme;
+  std::uint32_t dfd_byte_offset;
+  std::uint32_t dfd_byte_length;
+  std::uint32_t kvd_byte_offset;
+  std::uint32_t kvd_byte_length;
+  std::uint64_t sgd_byte_offset;
+  std::uint64_t sgd_byte_length;
+};
+
+struct FileLevel {
+  std::uint64_t byte_offset;
+  std::uint64_t byte_length;
+  std::uint64_t uncompressed_byte_length;
+};
+
+auto known_format(std::uint32_t vk_format) -> bool {
+  switch (static_cast<BlockFormat>(vk_format)) {
+    case BlockFormat::Bc1Rgb:
+    case BlockFormat::Bc1RgbSrgb:
+    case BlockFormat::Bc3Rgba:
+    case BlockFormat::Bc3RgbaSrgb:
+    case BlockFormat::Bc7Rgba:
+    case BlockFormat::Bc7RgbaSrgb:
+    case BlockFormat::Etc2Rgb:
+    case BlockFormat::Etc2RgbSrgb:
+    case BlockFormat::Etc2Rgba:
+    case BlockFormat::Etc2RgbaSrgb:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/* Data format descriptor of a BC1 texture: one basic descriptor block with
+   a single 64-bit sample covering the whole block. */
+auto bc1_descriptor(bool srgb) -> std::vector<std::uint32_t> {
+  constexpr std::uint32_t model_bc1a = 128;
+  constexpr std::uint32_t primaries_bt709 = 1;
+  const std::uint32_t transfer = srgb ? 2 : 1;
+  constexpr std::uint32_t block_size_bytes = 24 + 16;
+  return {
+      4 + block_size_bytes,
+      0,
+      2 | (block_size_bytes << 16),
+      model_bc1a | (primaries_bt709 << 8) | (transfer << 16),
+      3 | (3 << 8),
+      8,
+      0,
+      /* Bit offset 0, bit length 64 (stored minus one), BC1A color. */
+      63 << 16,
+      0,
+      0,
+      0xffffffff,
+  };
+}
+
+auto round_up(std::uint64_t n, std::uint64_t multiple) -> std::uint64_t {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+[[noreturn]] auto fail(std::string_view file_path, std::string_view reason)
+    -> void {
+  std::cerr << "[ERROR]: " << reason << " (" << file_path << ")\n";
+  std::exit(-1);
+}
+}  // namespace
+
+auto block_bytes(BlockFormat format) -> std::size_t {
+  switch (format) {
+    case BlockFormat::Bc1Rgb:
+    case BlockFormat::Bc1RgbSrgb:
+    case BlockFormat::Etc2Rgb:
+    case BlockFormat::Etc2RgbSrgb:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+auto compressed_size(BlockFormat format, int width, int height)
+    -> std::size_t {
+  const auto blocks_x =
+      static_cast<std::size_t>((width + block_size - 1) / block_size);
+  const auto blocks_y =
+      static_cast<std::size_t>((height + block_size - 1) / block_size);
+  return blocks_x * blocks_y * block_bytes(format);
+}
+
+auto Ktx2Texture::open(std::string_view file_path) -> Ktx2Texture {
+  auto file = MappedFile::open(file_path);
+  if (!file) fail(file_path, "Compressed texture does not exist");
+
+  FileHeader header;
+  if (file->size() < sizeof(header)) {
+    fail(file_path, "Compressed texture is truncated");
+  }
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.identifier, file_identifier,
+                  sizeof(file_identifier)) != 0) {
+    fail(file_path, "Not a KTX2 file");
+  }
+  if (!known_format(header.vk_format) || header.pixel_depth > 1 ||
+      header.layer_count > 1 ||
+      (header.face_count != 1 && header.face_count != 6) ||
+      header.supercompression_scheme != 0) {
+    fail(file_path,
+         "KTX2 file is not a block-compressed 2D or cube map texture");
+  }
+
+  Ktx2Texture t{};
+  t.format_ = static_cast<BlockFormat>(header.vk_format);
+  t.faces_ = static_cast<int>(header.face_count);
+  /* Zero levels asks the loader to generate mips, which compressed data
+     can't; upload the one that is there. */
+  const std::uint32_t level_count = std::max(header.level_count, 1u);
+  if (sizeof(header) + level_count * sizeof(FileLevel) > file->size()) {
+    fail(file_path, "Compressed texture is truncated");
+  }
+  for (std::uint32_t i = 0; i < level_count; ++i) {
+    FileLevel level;
+    std::memcpy(&level, file->data() + sizeof(header) + i * sizeof(level),
+                sizeof(level));
+    const int width = std::max(1, static_cast<int>(header.pixel_width >> i));
+    const int height =
+        std::max(1, static_cast<int>(header.pixel_height >> i));
+    const auto face_size = compressed_size(t.format_, width, height);
+    if (level.byte_length != face_size * t.faces_ ||
+        level.byte_offset + level.byte_length > file->size()) {
+      fail(file_path, "Compressed texture is truncated");
+    }
+    t.levels_.push_back({.width = width,
+                         .height = height,
+                         .data = file->data() + level.byte_offset,
+                         .face_size = face_size});
+  }
+  t.file_ = std::move(file);
+  return t;
+}
+
+auto write_ktx2(std::string_view file_path, BlockFormat format, int faces,
+                const std::vector<Ktx2Image>& levels) -> bool {
+  if (format != BlockFormat::Bc1Rgb && format != BlockFormat::Bc1RgbSrgb) {
+    return false;
+  }
+  const auto descriptor = bc1_descriptor(format == BlockFormat::Bc1RgbSrgb);
+  const auto descriptor_bytes = descriptor.size() * sizeof(std::uint32_t);
+
+  FileHeader header{};
+  std::memcpy(header.identifier, file_identifier, sizeof(file_identifier));
+  header.vk_format = static_cast<std::uint32_t>(format);
+  header.type_size = 1;
+  header.pixel_width = static_cast<std::uint32_t>(levels.front().width);
+  header.pixel_height = static_cast<std::uint32_t>(levels.front().height);
+  header.face_count = static_cast<std::uint32_t>(faces);
+  header.level_count = static_cast<std::uint32_t>(levels.size());
+  header.dfd_byte_offset =
+      static_cast<std::uint32_t>(sizeof(header) +
+                                 levels.size() * sizeof(FileLevel));
+  header.dfd_byte_length = static_cast<std::uint32_t>(descriptor_bytes);
+
+  /* Levels are stored smallest first, each aligned to the block size. */
+  std::vector<FileLevel> table(levels.size());
+  std::uint64_t offset = header.dfd_byte_offset + descriptor_bytes;
+  for (std::size_t i = levels.size(); i-- > 0;) {
+    offset = round_up(offset, block_bytes(format));
+    table[i] = {.byte_offset = offset,
+                .byte_length = levels[i].data.size(),
+                .uncompressed_byte_length = levels[i].data.size()};
+    offset += levels[i].data.size();
+  }
+
+  std::ofstream out{std::string{file_path}, std::ios::binary};
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(table.data()),
+            static_cast<std::streamsize>(table.size() * sizeof(FileLevel)));
+  out.write(reinterpret_cast<const char*>(descriptor.data()),
+            static_cast<std::streamsize>(descriptor_bytes));
+  for (std::size_t i = levels.size(); i-- > 0;) {
+    out.seekp(static_cast<std::streamoff>(table[i].byte_offset));
+    out.write(reinterpret_cast<const char*>(levels[i].data.data()),
+              static_cast<std::streamsize>(levels[i].data.size()));
+  }
+  return static_cast<bool>(out);
+}
@@ -8,39 +8,167 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include "decoded_image.hpp"
+#include "frame_timer.hpp"
+#include "gl_extensions.hpp"
+#include "input_recording.hpp"
+#include "resolution_governor.hpp"
 #include "shader.hpp"
+#include "sky_texture.hpp"
 #include "texture.hpp"
+#include "tile_renderer.hpp"
+#include "tracer.hpp"
 
 constexpr int opengl_version_major = 3;
 constexpr int opengl_version_minor = 3;
 constexpr int default_screen_width = 800;
 constexpr int default_screen_height = 600;
 constexpr const char* window_title = "Visualizing Wormholes";
+constexpr const char* default_sky = "../resources/textures/container.jpg";
+/* Linked shader programs are kept here, so later launches skip compiling
+   them. */
+constexpr const char* shader_cache_directory = "shader_cache";
 
 /* We render two triangles (a rectangle) that cover the entire screen
-   as we're rendering a single image. */
+   as we're rendering a single image. Images are uploaded top row first, so
+   the top of the screen samples t = 0. */
 // clang-format off
 constexpr float image_vertices[] = {
     // Positions         // Texture Coords
-    -1.0f, 1.0f,  0.0f,  0.0f,  1.0f, -1.0f, -1.0f, 0.0f,
-    0.0f,  0.0f,  1.0f,  -1.0f, 0.0f, 1.0f,  0.0f,
+    -1.0f, 1.0f,  0.0f,  0.0f,  0.0f, -1.0f, -1.0f, 0.0f,
+    0.0f,  1.0f,  1.0f,  -1.0f, 0.0f, 1.0f,  1.0f,
 
-    1.0f,  -1.0f, 0.0f,  1.0f,  0.0f, 1.0f,  1.0f,  0.0f,
-    1.0f,  1.0f,  -1.0f, 1.0f,  0.0f, 0.0f,  1.0f};
+    1.0f,  -1.0f, 0.0f,  1.0f,  1.0f, 1.0f,  1.0f,  0.0f,
+    1.0f,  0.0f,  -1.0f, 1.0f,  0.0f, 0.0f,  0.0f};
 // clang-format on
 
+/* Camera speeds per second held: throat radii along l, and radians. */
+constexpr double move_speed = 2.0;
+constexpr double turn_speed = 1.0;
+
+/* While camera keys are held the loop polls at this interval instead of
+   waiting for events, in seconds. */
+constexpr double input_interval = 1.0 / 120.0;
+
+/* Seconds between updates of the timings shown in the window title. */
+constexpr double title_interval = 1.0;
+constexpr std::string_view timings_flag = "--timings=";
+constexpr std::string_view record_flag = "--record=";
+constexpr std::string_view replay_flag = "--replay=";
+constexpr std::string_view headless_flag = "--headless";
+
+namespace {
+auto camera_keys(GLFWwindow* window) -> CameraKeys {
+  const auto axis = [&](int positive, int negative) {
+    return (glfwGetKey(window, positive) == GLFW_PRESS ? 1.0 : 0.0) -
+           (glfwGetKey(window, negative) == GLFW_PRESS ? 1.0 : 0.0);
+  };
+  return {.along = axis(GLFW_KEY_S, GLFW_KEY_W),
+          .around = axis(GLFW_KEY_D, GLFW_KEY_A),
+          .yaw = axis(GLFW_KEY_RIGHT, GLFW_KEY_LEFT),
+          .pitch = axis(GLFW_KEY_UP, GLFW_KEY_DOWN)};
+}
+
+/* Move CAMERA as KEYS say for DT seconds. */
+auto move_camera(Camera& camera, const CameraKeys& keys, double dt) -> void {
+  camera.l += keys.along * move_speed * dt;
+  camera.phi += keys.around * turn_speed * dt;
+  camera.yaw += keys.yaw * turn_speed * dt;
+  camera.pitch = std::clamp(camera.pitch + keys.pitch * turn_speed * dt,
+                            -M_PI / 2.0, M_PI / 2.0);
+}
+}  // namespace
+
 auto main(int argc, char** argv) -> int {
   if (argc == 1) {
     std::cout << "Using default resolution: " << default_screen_width << " x "
               << default_screen_height << '\n';
   }
 
+  /* Options start with "--"; everything else is a sky: an image, or a
+     tile file from tools/sky_tiler (FILE.vtex) for skies too large to
+     decode whole.
+       --timings=FILE  write every frame's timings to FILE as CSV.
+       --record=FILE   record the camera keys and path to FILE.
+       --replay=FILE   follow the input recorded in FILE instead of the
+                       keys, then exit: a repeatable benchmark.
+       --headless      don't show the window while replaying. */
+  std::vector<std::string> skies;
+  FrameTimerOptions timer_options{};
+  std::string record_path, replay_path;
+  bool headless = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with(timings_flag)) {
+      timer_options.csv_path = arg.substr(timings_flag.size());
+    } else if (arg.starts_with(record_flag)) {
+      record_path = arg.substr(record_flag.size());
+    } else if (arg.starts_with(replay_flag)) {
+      replay_path = arg.substr(replay_flag.size());
+    } else if (arg == headless_flag) {
+      headless = true;
+    } else if (arg.starts_with("--")) {
+      std::cerr << "[ERROR]: Unknown option (" << arg << ")\n";
+      return -1;
+    } else {
+      skies.emplace_back(arg);
+    }
+  }
+
+  /* The skies of the two universes; the lower one defaults to the upper. */
+  const std::string upper_sky_path = skies.size() > 0 ? skies[0] : default_sky;
+  const std::string lower_sky_path =
+      skies.size() > 1 ? skies[1] : upper_sky_path;
+
+  std::optional<InputReplay> replay;
+  if (!replay_path.empty()) {
+    replay = InputReplay::from_file(replay_path);
+    if (!replay) return -1;
+  } else if (headless) {
+    std::cerr << "[ERROR]: " << headless_flag << " needs " << replay_flag
+              << "FILE\n";
+    return -1;
+  }
+  std::optional<InputRecorder> recorder;
+  if (!record_path.empty()) {
+    recorder = InputRecorder::create(record_path);
+    if (!recorder) {
+      std::cerr << "[ERROR]: Failed to create input recording "
+                << record_path << '\n';
+      return -1;
+    }
+  }
+
+  /* Decoding a large sky takes seconds, so the skies are loaded on worker
+     threads while the window and shaders are set up, and the thumbnail of
+     the upper one (see DecodedImage::load_proxy) is shown until they are
+     done. When the lower sky defaults to the upper one it is loaded once
+     and shared. A sky that fails to load comes back empty, its error
+     printed, and the main thread exits. */
+  auto upper_loading = std::async(std::launch::async, [&] {
+    return SkyTexture::from_file(upper_sky_path);
+  });
+  std::future<std::optional<SkyTexture>> lower_loading;
+  if (lower_sky_path != upper_sky_path) {
+    lower_loading = std::async(std::launch::async, [&] {
+      return SkyTexture::from_file(lower_sky_path);
+    });
+  }
+
   /* TODO: Allow user to provide resolution themselves. */
 
   glfwSetErrorCallback([](int error, const char* description) {
@@ -60,9 +188,13 @@ auto main(int argc, char** argv) -> int {
   /* For MacOS compatability. */
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
+  /* A replay renders at the recorded sizes whatever the window's. */
   std::unique_ptr<GLFWwindow, decltype(&glfwDestroyWindow)> window{
-      glfwCreateWindow(default_screen_width, default_screen_height,
+      glfwCreateWindow(replay ? replay->current().width : default_screen_width,
+                       replay ? replay->current().height
+                              : default_screen_height,
                        window_title, nullptr, nullptr),
       glfwDestroyWindow};
 
@@ -76,6 +208,7 @@ auto main(int argc, char** argv) -> int {
   /* Initialize GLAD. */
 
   gladLoadGL(glfwGetProcAddress);
+  load_gl_extensions(glfwGetProcAddress);
   const GLubyte* version = glGetString(GL_VERSION);
   std::cout << "OpenGL version available: " << version << '\n';
 
@@ -87,13 +220,20 @@ auto main(int argc, char** argv) -> int {
   {
     auto vertex_shader = Shader::from_file("../resources/shaders/vertex.glsl",
                                            ShaderStep::Vertex);
-    vertex_shader.compile();
     auto fragment_shader = Shader::from_file(
         "../resources/shaders/fragment.glsl", ShaderStep::Fragment);
-    fragment_shader.compile();
-    if (!program.attach(vertex_shader).attach(fragment_shader).link()) {
-      return -1;
+    program.attach(vertex_shader)
+        .attach(fragment_shader)
+        .start_link(shader_cache_directory);
+    /* Show a blank frame while the driver builds the program in the
+       background, so the window responds from the start. */
+    while (!program.link_ready() && !glfwWindowShouldClose(window.get())) {
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      glfwSwapBuffers(window.get());
+      glfwWaitEventsTimeout(input_interval);
     }
+    if (!program.finish_link()) return -1;
   }
 
   // Set up vertex data, buffers, and configure vertex attributes
@@ -115,20 +255,215 @@ auto main(int argc, char** argv) -> int {
                         (void*)(3 * sizeof(float)));
   glEnableVertexAttribArray(1);
 
-  auto texture = Texture::from_file("../resources/textures/container.jpg");
-  texture.bind(0);
-  program.set_texture_uniform(texture, "texture0");
+  {
+    Texture thumbnail{};
+    const auto proxy = DecodedImage::load_proxy(upper_sky_path);
+    if (proxy) {
+      const auto& base = proxy->base();
+      thumbnail.bind(0);
+      thumbnail.allocate(base.width, base.height, base.channels);
+      thumbnail.update(0, 0, base.width, base.height, base.data);
+    }
+    const auto loaded = [](const std::future<std::optional<SkyTexture>>& sky) {
+      return !sky.valid() ||
+             sky.wait_for(std::chrono::seconds{0}) ==
+                 std::future_status::ready;
+    };
+    while (!(loaded(upper_loading) && loaded(lower_loading))) {
+      if (glfwWindowShouldClose(window.get())) return 0;
+      int width, height;
+      glfwGetFramebufferSize(window.get(), &width, &height);
+      glViewport(0, 0, width, height);
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      if (proxy) {
+        program.use();
+        program.set_texture_uniform(thumbnail, "texture0");
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+      }
+      glfwSwapBuffers(window.get());
+      glfwWaitEventsTimeout(input_interval);
+    }
+  }
+
+  /* The CPU renderer traces the frame in the background, a coarse preview
+     first and then progressively denser passes; each frame uploads the
+     latest one. Moving the camera just posts a new frame to the renderer,
+     which drops the old one, so input never waits for a trace.
+
+     While the camera moves, frames are rendered below the window's
+     resolution as the governor sees fit, to keep the time from input to
+     a new image within budget, and stretched over the window. Once the
+     camera rests, the frame is rendered again at full resolution. Rays are
+     traced more sparsely away from the throat. A replay always renders at
+     the recorded size, so its frames don't depend on how fast earlier ones
+     were. */
+  const auto upper_sky = upper_loading.get();
+  if (!upper_sky) return -1;
+  std::optional<SkyTexture> separate_lower_sky;
+  if (lower_loading.valid()) {
+    separate_lower_sky = lower_loading.get();
+    if (!separate_lower_sky) return -1;
+  }
+  const SkyTexture& lower_sky =
+      separate_lower_sky ? *separate_lower_sky : *upper_sky;
+  TileRenderer renderer{*upper_sky,
+                        lower_sky,
+                        {.sampling = {.foveation = FoveationOptions{}},
+                         .progressive = true,
+                         .samples_per_pixel = 4,
+                         .on_ready = [] { glfwPostEmptyEvent(); }}};
+  ResolutionGovernor governor{};
+  Camera camera{};
+
+  int window_width = 0, window_height = 0;
+  int render_width = 0, render_height = 0;
+  Texture frame{};
+  frame.bind(0);
 
+  /* Frames are only drawn when something changed: the camera moved, the
+     window was resized or exposed, or the renderer has a new pass, which
+     wakes the loop through on_ready. Otherwise it sleeps in
+     glfwWaitEvents. */
+  bool needs_redraw = true;
+  glfwSetWindowUserPointer(window.get(), &needs_redraw);
+  glfwSetWindowRefreshCallback(window.get(), [](GLFWwindow* w) {
+    *static_cast<bool*>(glfwGetWindowUserPointer(w)) = true;
+  });
+
+  /* Every drawn frame is timed; the percentiles so far are shown in the
+     window title and printed on exit. */
+  FrameTimer timer{timer_options};
+  double title_time = glfwGetTime();
+
+  /* When the oldest input not yet on screen was posted, if any. */
+  std::optional<double> waiting_since;
+  /* Whether the loop slept since the last iteration, which isn't time the
+     camera keys were held for. */
+  bool slept = true;
+  /* The keys last written to the recording. */
+  CameraKeys recorded_keys{};
+  const double start_time = glfwGetTime();
+  double last_time = start_time;
   while (!glfwWindowShouldClose(window.get())) {
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    timer.begin_frame();
+    const double time = glfwGetTime();
+    CameraKeys keys;
+    bool moved;
+    int width, height;
+    if (replay) {
+      replay->advance(time - start_time);
+      const auto& input = replay->current();
+      keys = input.keys;
+      moved = input.camera != camera;
+      camera = input.camera;
+      width = input.width;
+      height = input.height;
+    } else {
+      keys = camera_keys(window.get());
+      moved = keys.held() && !slept;
+      if (moved) move_camera(camera, keys, time - last_time);
+      glfwGetFramebufferSize(window.get(), &width, &height);
+    }
+    last_time = time;
+
+    const bool resized = width > 0 && height > 0 &&
+                         (width != window_width || height != window_height);
+    if (resized) {
+      window_width = width;
+      window_height = height;
+      glViewport(0, 0, width, height);
+      needs_redraw = true;
+    }
+    if (recorder && (moved || resized || keys != recorded_keys)) {
+      recorder->record({.time = time - start_time,
+                        .keys = keys,
+                        .camera = camera,
+                        .width = window_width,
+                        .height = window_height});
+      recorded_keys = keys;
+    }
+    if ((moved || resized) && window_width > 0) {
+      std::tie(render_width, render_height) =
+          replay ? std::pair{window_width, window_height}
+                 : governor.resolution(window_width, window_height);
+      renderer.render(camera, render_width, render_height);
+      if (!waiting_since) waiting_since = time;
+    }
+    timer.end_stage(FrameStage::Input);
+
+    const auto tiles = renderer.finished_tiles();
+    /* A pass of a superseded frame may have been traced before the input
+       was even posted, so only passes of the current frame are timed. */
+    if (!tiles.empty() && renderer.current() && waiting_since) {
+      governor.report(glfwGetTime() - *waiting_since);
+      waiting_since.reset();
+    }
+    timer.end_stage(FrameStage::Compute);
+    for (const auto& tile : tiles) {
+      /* Passes cover their whole frame, which may be of an earlier size. */
+      if (tile.width != frame.width() || tile.height != frame.height()) {
+        frame.allocate(tile.width, tile.height, 4);
+      }
+      frame.update(tile.x, tile.y, tile.width, tile.height, tile.rgba.data());
+      needs_redraw = true;
+    }
+    timer.end_stage(FrameStage::Upload);
+    if (!keys.held() && renderer.done() &&
+        (render_width != window_width || render_height != window_height)) {
+      render_width = window_width;
+      render_height = window_height;
+      renderer.render(camera, render_width, render_height);
+    }
 
-    program.use();
-    glBindVertexArray(VAO);
+    if (needs_redraw) {
+      timer.begin_gpu();
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
 
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+      program.use();
+      program.set_texture_uniform(frame, "texture0");
+      glBindVertexArray(VAO);
 
-    glfwSwapBuffers(window.get());
-    glfwPollEvents();
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+      timer.end_gpu();
+      timer.end_stage(FrameStage::Draw);
+
+      glfwSwapBuffers(window.get());
+      timer.end_stage(FrameStage::Swap);
+      timer.end_frame();
+      needs_redraw = false;
+
+      if (time - title_time >= title_interval && timer.frame().count() > 0) {
+        const auto title = std::string{window_title} + " | " + timer.summary();
+        glfwSetWindowTitle(window.get(), title.c_str());
+        title_time = time;
+      }
+    }
+
+    if (replay) {
+      /* Done once the last input's frame is on screen at full resolution;
+         until then, wake when the next input is due. */
+      const auto next_time = replay->next_time();
+      if (!next_time && renderer.done()) break;
+      const double wait =
+          next_time ? *next_time - (glfwGetTime() - start_time) : 0.0;
+      if (!next_time) {
+        glfwWaitEvents();
+      } else if (wait > 0.0) {
+        glfwWaitEventsTimeout(wait);
+      } else {
+        glfwPollEvents();
+      }
+    } else if (keys.held()) {
+      glfwWaitEventsTimeout(input_interval);
+      slept = false;
+    } else {
+      glfwWaitEvents();
+      slept = true;
+    }
   }
+
+  timer.report(std::cout);
 }
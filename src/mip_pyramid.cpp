@@ -0,0 +1,182 @@
+#include "mip_pyramid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "detail/simd.hpp"
+#include "parallel.hpp"
+#include "srgb.hpp"
+
+namespace {
+using detail::simd::f32x4;
+using detail::simd::f32x8;
+
+/* Output rows produced per parallel work item. Each band re-filters the few
+   input rows it shares with its neighbours. */
+constexpr int band_rows = 32;
+
+/* A separable decimation filter: output texel i reads input texels
+   2i + first .. 2i + first + count - 1. */
+struct Taps {
+  int first;
+  int count;
+  std::array<float, 6> weights;
+};
+
+auto bessel_i0(double x) -> double {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+auto kaiser_taps() -> Taps {
+  constexpr double beta = 4.0;
+  constexpr double radius = 3.0;
+  Taps taps{.first = -2, .count = 6, .weights = {}};
+  double total = 0.0;
+  for (int k = 0; k < taps.count; ++k) {
+    /* Distance from the output texel's center, in input texels. */
+    const double d = k - 2.5;
+    const double x = M_PI * d / 2.0;
+    const double sinc = std::sin(x) / x;
+    const double t = d / radius;
+    const double window =
+        bessel_i0(beta * std::sqrt(1.0 - t * t)) / bessel_i0(beta);
+    taps.weights[k] = static_cast<float>(sinc * window);
+    total += taps.weights[k];
+  }
+  for (auto& w : taps.weights) w = static_cast<float>(w / total);
+  return taps;
+}
+
+auto taps_for(MipFilter filter) -> const Taps& {
+  static const Taps box{.first = 0, .count = 2, .weights = {0.5f, 0.5f}};
+  static const Taps kaiser = kaiser_taps();
+  return filter == MipFilter::Box ? box : kaiser;
+}
+
+/* Decode row Y of IMAGE to linear and filter it horizontally into OUT, four floats per
+   output texel regardless of the channel count so every texel is one f32x4.
+   SOURCE has room for the decoded input row. */
+auto filter_row(const Image& image, int y, const Taps& taps,
+                const std::vector<int>& columns, int out_width, float* source,
+                float* out) -> void {
+  const unsigned char* p = image.texel(0, y);
+  for (int x = 0; x < image.width; ++x, p += image.channels) {
+    for (int c = 0; c < 4; ++c) {
+      source[x * 4 + c] =
+          c >= image.channels                 ? 0.0f
+          : is_alpha_channel(c, image.channels) ? alpha_to_float(p[c])
+                                                : srgb_to_linear(p[c]);
+    }
+  }
+  const int* column = columns.data();
+  for (int x = 0; x < out_width; ++x, column += taps.count) {
+    f32x4 sum{};
+    for (int k = 0; k < taps.count; ++k) {
+      f32x4 texel;
+      detail::simd::load(texel, source + column[k] * 4);
+      sum += taps.weights[k] * texel;
+    }
+    detail::simd::store(out + x * 4, sum);
+  }
+}
+
+/* OUT[i] = sum_k weights[k] * ROWS[k][i] over SIZE floats. */
+auto filter_column(const Taps& taps, const float* const* rows, int size,
+                   float* out) -> void {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    f32x8 sum{};
+    for (int k = 0; k < taps.count; ++k) {
+      f32x8 row;
+      detail::simd::load(row, rows[k] + i);
+      sum += taps.weights[k] * row;
+    }
+    detail::simd::store(out + i, sum);
+  }
+  for (; i < size; ++i) {
+    float sum = 0.0f;
+    for (int k = 0; k < taps.count; ++k) sum += taps.weights[k] * rows[k][i];
+    out[i] = sum;
+  }
+}
+
+auto downsample(const Image& image, const Taps& taps, bool wrap_x) -> Image {
+  Image half{.width = std::max(1, image.width / 2),
+             .height = std::max(1, image.height / 2),
+             .channels = image.channels,
+             .data = {}};
+  half.data.resize(static_cast<std::size_t>(half.width) * half.height *
+                   half.channels);
+
+  /* Input columns of every output texel. */
+  std::vector<int> columns(static_cast<std::size_t>(half.width) * taps.count);
+  for (int x = 0; x < half.width; ++x) {
+    for (int k = 0; k < taps.count; ++k) {
+      const int i = 2 * x + taps.first + k;
+      columns[x * taps.count + k] =
+          wrap_x ? ((i % image.width) + image.width) % image.width
+                 : std::clamp(i, 0, image.width - 1);
+    }
+  }
+  const auto clamp_row = [&](int y) {
+    return std::clamp(y, 0, image.height - 1);
+  };
+
+  const int bands = (half.height + band_rows - 1) / band_rows;
+  const int row_size = half.width * 4;
+  parallel_for(bands, [&](auto band) {
+    const int y0 = static_cast<int>(band) * band_rows;
+    const int y1 = std::min(y0 + band_rows, half.height);
+    const int first_row = 2 * y0 + taps.first;
+    const int row_count = 2 * (y1 - 1) + taps.first + taps.count - first_row;
+
+    std::vector<float> source(static_cast<std::size_t>(image.width) * 4);
+    std::vector<float> filtered(static_cast<std::size_t>(row_count) *
+                                row_size);
+    for (int r = 0; r < row_count; ++r) {
+      filter_row(image, clamp_row(first_row + r), taps, columns, half.width,
+                 source.data(), filtered.data() + r * row_size);
+    }
+
+    std::vector<float> out(row_size);
+    std::array<const float*, 6> rows{};
+    for (int y = y0; y < y1; ++y) {
+      for (int k = 0; k < taps.count; ++k) {
+        rows[k] = filtered.data() + (2 * y + k - 2 * y0) * row_size;
+      }
+      filter_column(taps, rows.data(), row_size, out.data());
+
+      unsigned char* dst =
+          half.data.data() + static_cast<std::size_t>(y) * half.width *
+                                 half.channels;
+      for (int x = 0; x < half.width; ++x) {
+        for (int c = 0; c < half.channels; ++c) {
+          dst[x * half.channels + c] =
+              is_alpha_channel(c, half.channels)
+                  ? float_to_alpha(out[x * 4 + c])
+                  : linear_to_srgb(out[x * 4 + c]);
+        }
+      }
+    }
+  });
+  return half;
+}
+}  // namespace
+
+auto build_mip_pyramid(Image base, MipFilter filter, bool wrap_x)
+    -> std::vector<Image> {
+  const auto& taps = taps_for(filter);
+  std::vector<Image> levels;
+  levels.push_back(std::move(base));
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    levels.push_back(downsample(levels.back(), taps, wrap_x));
+  }
+  return levels;
+}
@@ -0,0 +1,25 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+auto parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn)
+    -> void {
+  const std::size_t workers = std::min<std::size_t>(
+      count, std::max(1u, std::thread::hardware_concurrency()));
+  std::atomic<std::size_t> next{0};
+
+  const auto work = [&]() {
+    for (auto i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::jthread> threads;
+  for (std::size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+}
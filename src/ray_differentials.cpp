@@ -0,0 +1,98 @@
+#include "ray_differentials.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+
+#include "parallel.hpp"
+
+namespace {
+/* Offset, in pixels, of the extra rays of a bundle. */
+constexpr double bundle_offset = 0.25;
+
+/* Difference of the map around pixel (X, Y) along (STEP_X, STEP_Y): central
+   in the interior, one-sided at the image border. Nothing if a neighbour is
+   in another universe or the one-sided differences disagree too much for the
+   map to be considered smooth there. */
+auto map_difference(const SkyMap& map, int x, int y, int step_x, int step_y)
+    -> std::optional<Vec3> {
+  const auto in_bounds = [&](int px, int py) {
+    return px >= 0 && py >= 0 && px < map.width() && py < map.height();
+  };
+  const auto& center = map.at(x, y);
+  const bool has_before = in_bounds(x - step_x, y - step_y);
+  const bool has_after = in_bounds(x + step_x, y + step_y);
+  if (!has_before && !has_after) return std::nullopt;
+
+  std::optional<Vec3> forward;
+  std::optional<Vec3> backward;
+  if (has_after) {
+    const auto& after = map.at(x + step_x, y + step_y);
+    if (after.universe != center.universe) return std::nullopt;
+    forward = after.direction - center.direction;
+  }
+  if (has_before) {
+    const auto& before = map.at(x - step_x, y - step_y);
+    if (before.universe != center.universe) return std::nullopt;
+    backward = center.direction - before.direction;
+  }
+  if (!forward) return backward;
+  if (!backward) return forward;
+
+  const double limit = 0.5 * std::max(length(*forward), length(*backward));
+  if (length(*forward - *backward) > limit + 1e-9) return std::nullopt;
+  return 0.5 * (*forward + *backward);
+}
+
+/* Differential from a ray offset by +-bundle_offset pixels along (STEP_X,
+   STEP_Y); the negative offset is only tried if the positive one crosses into
+   the other universe. Adds the rays traced to TRACED. */
+auto bundle_difference(const RayGenerator& rays, const SkySample& center,
+                       double x, double y, double step_x, double step_y,
+                       std::size_t& traced) -> Vec3 {
+  for (const double sign : {1.0, -1.0}) {
+    const double h = sign * bundle_offset;
+    const auto offset = trace(rays.camera(),
+                              rays.direction(x + h * step_x, y + h * step_y));
+    ++traced;
+    if (offset.universe == center.universe) {
+      return (1.0 / h) * (offset.direction - center.direction);
+    }
+  }
+  return {0.0, 0.0, 0.0};
+}
+}  // namespace
+
+auto compute_differentials(const Camera& camera, SkyMap& map) -> std::size_t {
+  const int width = map.width();
+  const int height = map.height();
+  const RayGenerator rays{camera, map.window().image_width,
+                          map.window().image_height};
+  const double stride = map.window().stride;
+
+  std::atomic<std::size_t> traced{0};
+  parallel_for(height, [&](auto row) {
+    const int y = static_cast<int>(row);
+    const double image_y = map.image_y(y);
+    std::size_t row_traced = 0;
+    for (int x = 0; x < width; ++x) {
+      const double image_x = map.image_x(x);
+      const auto& center = map.at(x, y);
+      auto& footprint = map.footprint(x, y);
+      if (auto dx = map_difference(map, x, y, 1, 0)) {
+        footprint.dx = *dx;
+      } else {
+        footprint.dx = bundle_difference(rays, center, image_x, image_y,
+                                         stride, 0, row_traced);
+      }
+      if (auto dy = map_difference(map, x, y, 0, 1)) {
+        footprint.dy = *dy;
+      } else {
+        footprint.dy = bundle_difference(rays, center, image_x, image_y, 0,
+                                         stride, row_traced);
+      }
+    }
+    traced += row_traced;
+  });
+  return traced;
+}
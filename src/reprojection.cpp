@@ -0,0 +1,138 @@
+#include "reprojection.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "parallel.hpp"
+
+namespace {
+/* How far apart, beyond what their footprints predict, neighbouring samples
+   may be and still be interpolated: a fraction of the difference, and an
+   angle on the sky in radians. */
+constexpr double footprint_slack = 0.5;
+constexpr double angle_slack = 5e-4;
+/* Largest error, as an angle on the sky in radians, interpolating between
+   two neighbouring samples may make. Bilinear interpolation is off by up to
+   an eighth of how much the step between pixels changes from one to the
+   next, which is large around the Einstein ring. */
+constexpr double tolerance = 5e-4;
+
+/* A rotation by an angle with cosine COS and sine SIN about the unit AXIS. */
+struct Rotation {
+  Vec3 axis;
+  double cos;
+  double sin;
+
+  auto apply(Vec3 v) const -> Vec3 {
+    return cos * v + sin * cross(axis, v) + (1.0 - cos) * dot(axis, v) * axis;
+  }
+  auto inverse() const -> Rotation { return {axis, cos, -sin}; }
+};
+
+/* The shortest rotation taking unit vector FROM to unit vector TO. */
+auto rotation_between(Vec3 from, Vec3 to) -> Rotation {
+  const Vec3 axis = cross(from, to);
+  const double sin = length(axis);
+  const double cos = dot(from, to);
+  if (sin > 1e-12) return {(1.0 / sin) * axis, cos, sin};
+  if (cos > 0.0) return {{0.0, 0.0, 1.0}, 1.0, 0.0};
+  /* Opposite: half a turn about any perpendicular axis. */
+  const Vec3 other =
+      std::abs(from.x) < 0.9 ? Vec3{1.0, 0.0, 0.0} : Vec3{0.0, 1.0, 0.0};
+  return {normalize(cross(from, other)), -1.0, 0.0};
+}
+
+/* Whether neighbouring samples A and B, STEP_A and STEP_B being their
+   footprints along the axis joining them, lie on one smooth piece of the
+   map. */
+auto continuous(const SkySample& a, const SkySample& b, Vec3 step_a,
+                Vec3 step_b) -> bool {
+  if (a.universe != b.universe) return false;
+  const double step = std::max(length(step_a), length(step_b));
+  return length(step_b - step_a) <= 8.0 * tolerance &&
+         length(b.direction - a.direction) <=
+             (1.0 + footprint_slack) * step + angle_slack;
+}
+
+/* Interpolate PREVIOUS at image coordinates (X, Y), if the four pixels
+   around them are continuous. */
+auto interpolate(const SkyMap& previous, double x, double y)
+    -> std::optional<SkySample> {
+  const int width = previous.width();
+  const int height = previous.height();
+  /* Pixel centers sit at half-integer coordinates. */
+  const double fx = x - 0.5;
+  const double fy = y - 0.5;
+  if (width < 2 || height < 2 || !(fx >= 0.0 && fx <= width - 1.0) ||
+      !(fy >= 0.0 && fy <= height - 1.0)) {
+    return std::nullopt;
+  }
+  const int x0 = std::min(static_cast<int>(fx), width - 2);
+  const int y0 = std::min(static_cast<int>(fy), height - 2);
+  const double tx = fx - x0;
+  const double ty = fy - y0;
+
+  const auto& s00 = previous.at(x0, y0);
+  const auto& s10 = previous.at(x0 + 1, y0);
+  const auto& s01 = previous.at(x0, y0 + 1);
+  const auto& s11 = previous.at(x0 + 1, y0 + 1);
+  const auto& f00 = previous.footprint(x0, y0);
+  const auto& f10 = previous.footprint(x0 + 1, y0);
+  const auto& f01 = previous.footprint(x0, y0 + 1);
+  const auto& f11 = previous.footprint(x0 + 1, y0 + 1);
+  if (!continuous(s00, s10, f00.dx, f10.dx) ||
+      !continuous(s01, s11, f01.dx, f11.dx) ||
+      !continuous(s00, s01, f00.dy, f01.dy) ||
+      !continuous(s10, s11, f10.dy, f11.dy)) {
+    return std::nullopt;
+  }
+
+  const Vec3 top = (1.0 - tx) * s00.direction + tx * s10.direction;
+  const Vec3 bottom = (1.0 - tx) * s01.direction + tx * s11.direction;
+  return SkySample{.direction = normalize((1.0 - ty) * top + ty * bottom),
+                   .universe = s00.universe};
+}
+}  // namespace
+
+auto reproject(const Camera& previous_camera, const SkyMap& previous,
+               const Camera& camera, SkyMap& map)
+    -> std::optional<ReprojectionStats> {
+  if (camera.l != previous_camera.l) return std::nullopt;
+
+  /* Rotating the camera's position onto the previous one takes every ray,
+     and where it lands, along with it. */
+  const Rotation to_previous = rotation_between(
+      angular_position(camera), angular_position(previous_camera));
+  const Rotation from_previous = to_previous.inverse();
+  const RayGenerator rays{camera, map.window().image_width,
+                          map.window().image_height};
+  const RayGenerator previous_rays{previous_camera, previous.width(),
+                                   previous.height()};
+
+  std::atomic<std::size_t> traced{0};
+  parallel_for(map.height(), [&](auto row) {
+    const int y = static_cast<int>(row);
+    const double image_y = map.image_y(y);
+    std::size_t row_traced = 0;
+    for (int x = 0; x < map.width(); ++x) {
+      const Vec3 direction = rays.direction(map.image_x(x), image_y);
+      std::optional<SkySample> sample;
+      if (const auto position =
+              previous_rays.image_position(to_previous.apply(direction))) {
+        sample = interpolate(previous, position->first, position->second);
+      }
+      if (sample) {
+        map.at(x, y) = {.direction = from_previous.apply(sample->direction),
+                        .universe = sample->universe};
+      } else {
+        map.at(x, y) = trace(camera, direction);
+        ++row_traced;
+      }
+    }
+    traced += row_traced;
+  });
+
+  const auto pixels = static_cast<std::size_t>(map.width()) * map.height();
+  return ReprojectionStats{.reused = pixels - traced, .traced = traced};
+}
@@ -0,0 +1,36 @@
+#include "resolution_governor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double scale_steps = 20.0;
+}  // namespace
+
+ResolutionGovernor::ResolutionGovernor(ResolutionGovernorOptions options)
+    : options_{options}, scale_{options.max_scale} {}
+
+auto ResolutionGovernor::report(double seconds) -> void {
+  seconds_ = seconds_ == 0.0 ? seconds
+                             : options_.smoothing * seconds +
+                                   (1.0 - options_.smoothing) * seconds_;
+  const double ratio = seconds_ / options_.target_seconds;
+  if (std::abs(ratio - 1.0) <= options_.tolerance) return;
+
+  /* Aim a little under the target, so noise doesn't push frames over it
+     right away. */
+  const double aim = 1.0 - options_.tolerance / 2.0;
+  const double wanted = std::clamp(
+      std::round(scale_ * std::sqrt(aim / ratio) * scale_steps) / scale_steps,
+      options_.min_scale, options_.max_scale);
+  if (wanted == scale_) return;
+  scale_ = wanted;
+  /* Frames at the old scale say little about the new one. */
+  seconds_ = 0.0;
+}
+
+auto ResolutionGovernor::resolution(int width, int height) const
+    -> std::pair<int, int> {
+  return {std::max(1, static_cast<int>(std::lround(width * scale_))),
+          std::max(1, static_cast<int>(std::lround(height * scale_)))};
+}
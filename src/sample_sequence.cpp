@@ -0,0 +1,65 @@
+#include "sample_sequence.hpp"
+
+namespace {
+auto reverse_bits(std::uint32_t x) -> std::uint32_t {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+auto hash(std::uint32_t x) -> std::uint32_t {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+/* Permutes the bits of X, each depending only on the bits below it, which
+   (applied to reversed bits) is an Owen scramble. */
+auto laine_karras_permutation(std::uint32_t x, std::uint32_t seed)
+    -> std::uint32_t {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+auto owen_scramble(std::uint32_t x, std::uint32_t seed) -> std::uint32_t {
+  return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+/* The first two Sobol dimensions as 0.32 fixed point. The first is the van
+   der Corput sequence. */
+auto sobol_0(std::uint32_t index) -> std::uint32_t {
+  return reverse_bits(index);
+}
+
+auto sobol_1(std::uint32_t index) -> std::uint32_t {
+  std::uint32_t result = 0;
+  for (std::uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+    if (index & 1u) result ^= v;
+  }
+  return result;
+}
+
+constexpr double to_unit = 1.0 / 4294967296.0;
+}  // namespace
+
+auto sobol_2d(std::uint32_t index, std::uint32_t seed)
+    -> std::pair<double, double> {
+  const std::uint32_t shuffled = owen_scramble(index, seed);
+  return {owen_scramble(sobol_0(shuffled), hash(seed ^ 0xa511e9b3u)) * to_unit,
+          owen_scramble(sobol_1(shuffled), hash(seed ^ 0x63d83595u)) *
+              to_unit};
+}
+
+auto pixel_seed(int x, int y) -> std::uint32_t {
+  return hash(static_cast<std::uint32_t>(x) ^
+              hash(static_cast<std::uint32_t>(y) + 0x9e3779b9u));
+}
@@ -2,19 +2,131 @@
 
 #include <glad/gl.h>
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <sstream>
+
+#include "content_hash.hpp"
+#include "gl_extensions.hpp"
+#include "mapped_file.hpp"
 
 Shader::Shader(std::string src, ShaderStep step)
-    : src_{std::move(src)}, step_{step} {}
+    : detail::GLObject{0}, src_{std::move(src)}, step_{step} {}
 
 static constexpr auto translate_step(ShaderStep step) {
   return step == ShaderStep::Vertex ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
 }
 
-auto Shader::compile() -> bool {
+namespace {
+constexpr char binary_magic[4] = {'W', 'H', 'P', 'B'};
+constexpr std::uint32_t binary_version = 1;
+
+struct BinaryHeader {
+  char magic[4];
+  std::uint32_t version;
+  /* As returned by glGetProgramBinary. */
+  std::uint32_t format;
+  std::uint32_t length;
+};
+
+/* Where the binary of a program is cached in DIRECTORY, given SOURCES, its
+   shaders' steps and sources. The current driver is part of the key. */
+auto binary_path(std::string_view directory, std::string sources)
+    -> std::filesystem::path {
+  std::string key = std::move(sources);
+  for (const auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    key += reinterpret_cast<const char*>(glGetString(name));
+    key += '\0';
+  }
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0')
+       << content_hash(reinterpret_cast<const unsigned char*>(key.data()),
+                       key.size())
+       << ".program";
+  return std::filesystem::path{directory} / name.str();
+}
+
+/* Load PROGRAM from the binary at PATH. Returns whether it is now linked. */
+auto load_binary(GLuint program, const std::filesystem::path& path) -> bool {
+  const auto file = MappedFile::open(path.string());
+  if (!file) return false;
+  BinaryHeader header;
+  if (file->size() < sizeof(header)) return false;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0 ||
+      header.version != binary_version ||
+      sizeof(header) + header.length > file->size()) {
+    return false;
+  }
+  /* Binaries in a format the driver doesn't take would raise a GL error. */
+  GLint format_count = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+  std::vector<GLint> formats(static_cast<std::size_t>(format_count));
+  glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+  if (std::find(formats.begin(), formats.end(),
+                static_cast<GLint>(header.format)) == formats.end()) {
+    return false;
+  }
+  gl_extensions().program_binary(program, header.format,
+                                 file->data() + sizeof(header),
+                                 static_cast<GLsizei>(header.length));
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  return success;
+}
+
+/* Save the binary of the linked PROGRAM to PATH. Goes through a temporary
+   file so concurrent launches never load a half-written binary; failing to
+   write just means compiling next time. The temporary name carries the
+   process id and a per-process count, so threads can't collide either. */
+auto save_binary(GLuint program, const std::filesystem::path& path) -> void {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+  std::vector<char> binary(static_cast<std::size_t>(length));
+  GLenum format = 0;
+  gl_extensions().get_program_binary(program, length, &length, &format,
+                                     binary.data());
+
+  BinaryHeader header{};
+  std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+  header.version = binary_version;
+  header.format = format;
+  header.length = static_cast<std::uint32_t>(length);
+
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+  auto temp_path = path;
+  static std::atomic<unsigned> next_temp{0};
+  temp_path += "." + std::to_string(::getpid()) + "." +
+               std::to_string(next_temp++);
+  {
+    std::ofstream out{temp_path, std::ios::binary};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(binary.data(), length);
+    if (out) {
+      out.close();
+      std::filesystem::rename(temp_path, path, error);
+      if (!error) return;
+    }
+  }
+  std::filesystem::remove(temp_path, error);
+}
+}  // namespace
+
+auto Shader::compile() -> bool { return start_compile() && finish_compile(); }
+
+auto Shader::start_compile() -> bool {
   auto gl_src = static_cast<const GLchar*>(src_.data());
 
   GLid = glCreateShader(translate_step(step_));
@@ -26,7 +138,10 @@ auto Shader::compile() -> bool {
 
   glShaderSource(GLid, 1, &gl_src, nullptr);
   glCompileShader(GLid);
+  return true;
+}
 
+auto Shader::finish_compile() -> bool {
   GLint success;
   glGetShaderiv(GLid, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -48,23 +163,85 @@ auto Shader::from_file(std::string_view file_path, ShaderStep step) -> Shader {
                 step};
 }
 
-auto ShaderProgram::attach(const Shader& shader) -> ShaderProgram& {
-  glAttachShader(GLid, shader.GLid);
+auto ShaderProgram::attach(Shader& shader) -> ShaderProgram& {
+  shaders_.push_back(&shader);
+  if (shader.src_.find("GL_ARB_bindless_texture") != std::string::npos) {
+    bindless_ = true;
+  }
   return *this;
 }
 
 auto ShaderProgram::use() -> void { glUseProgram(GLid); }
 
-auto ShaderProgram::link() -> bool {
+auto ShaderProgram::link(std::string_view cache_directory) -> bool {
+  start_link(cache_directory);
+  return finish_link();
+}
+
+auto ShaderProgram::start_link(std::string_view cache_directory) -> void {
+  cache_path_.clear();
+  from_cache_ = false;
+  start_failed_ = false;
+  if (!cache_directory.empty() && gl_extensions().program_binary) {
+    std::string sources;
+    for (const auto* shader : shaders_) {
+      sources += static_cast<char>(shader->step_);
+      sources += shader->src_;
+      sources += '\0';
+    }
+    cache_path_ = binary_path(cache_directory, std::move(sources)).string();
+    if (load_binary(GLid, cache_path_)) {
+      from_cache_ = true;
+      return;
+    }
+  }
+
+  /* No compile status is asked for until finish_link, so the driver is
+     free to compile every shader and link in the background. */
+  GLint attached = 0;
+  glGetProgramiv(GLid, GL_ATTACHED_SHADERS, &attached);
+  for (auto* shader : shaders_) {
+    if (shader->GLid == 0 && !shader->start_compile()) {
+      start_failed_ = true;
+      return;
+    }
+    if (attached == 0) glAttachShader(GLid, shader->GLid);
+  }
+  if (!cache_path_.empty()) {
+    gl_extensions().program_parameteri(
+        GLid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
   glLinkProgram(GLid);
+}
+
+auto ShaderProgram::link_ready() const -> bool {
+  if (from_cache_ || start_failed_ ||
+      !gl_extensions().max_shader_compiler_threads) {
+    return true;
+  }
+  GLint done = GL_FALSE;
+  glGetProgramiv(GLid, GL_COMPLETION_STATUS_KHR, &done);
+  return done;
+}
+
+auto ShaderProgram::finish_link() -> bool {
+  if (start_failed_) return false;
+  if (from_cache_) return true;
   GLint success;
   glGetProgramiv(GLid, GL_LINK_STATUS, &success);
   if (!success) {
+    /* A shader that failed to compile explains why better than the link
+       log does. */
+    for (auto* shader : shaders_) {
+      if (!shader->finish_compile()) return false;
+    }
     std::array<char, 512> log{};
     glGetProgramInfoLog(GLid, log.size(), nullptr, log.data());
     std::cerr << "[ERROR]: Shader failed to link: " << log.data() << '\n';
+    return false;
   }
-  return success;
+  if (!cache_path_.empty()) save_binary(GLid, cache_path_);
+  return true;
 }
 
 auto ShaderProgram::set_texture_uniform(const Texture& texture,
@@ -72,3 +249,19 @@ auto ShaderProgram::set_texture_uniform(const Texture& texture,
   const auto loc = glGetUniformLocation(GLid, uniform_name.data());
   glUniform1i(loc, texture.texture_unit());
 }
+
+auto ShaderProgram::set_texture_uniform(const TextureArray& textures,
+                                        std::string_view uniform_name) -> void {
+  const auto loc = glGetUniformLocation(GLid, uniform_name.data());
+  if (bindless_ && textures.handle() != 0) {
+    gl_extensions().uniform_handle(loc, textures.handle());
+    return;
+  }
+  glUniform1i(loc, textures.texture_unit());
+}
+
+auto ShaderProgram::set_layer_uniform(int layer,
+                                      std::string_view uniform_name) -> void {
+  const auto loc = glGetUniformLocation(GLid, uniform_name.data());
+  glUniform1i(loc, layer);
+}
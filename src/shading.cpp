@@ -0,0 +1,95 @@
+#include "shading.hpp"
+
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "srgb.hpp"
+
+namespace {
+auto write(const Color& color, unsigned char* out) -> void {
+  out[0] = linear_to_srgb(color.r);
+  out[1] = linear_to_srgb(color.g);
+  out[2] = linear_to_srgb(color.b);
+  out[3] = float_to_alpha(color.a);
+}
+
+auto shade_row_ewa(const SkyMap& map, const SkyTexture& upper_sky,
+                   const SkyTexture& lower_sky, int y, unsigned char* out)
+    -> void {
+  for (int x = 0; x < map.width(); ++x, out += 4) {
+    const auto& sample = map.at(x, y);
+    const auto& sky =
+        sample.universe == Universe::Upper ? upper_sky : lower_sky;
+    write(sky.sample(sample.direction, map.footprint(x, y)), out);
+  }
+}
+
+/* Batches the row's pixels per universe so each gather reads one texture.
+   Cube map skies have no batched path and are sampled pixel by pixel. */
+auto shade_row_trilinear(const SkyMap& map, const SkyTexture& upper_sky,
+                         const SkyTexture& lower_sky, int y,
+                         unsigned char* out) -> void {
+  for (const auto universe : {Universe::Upper, Universe::Lower}) {
+    const auto& sky = universe == Universe::Upper ? upper_sky : lower_sky;
+    if (sky.layout() == SkyLayout::Cubemap) {
+      for (int x = 0; x < map.width(); ++x) {
+        const auto& sample = map.at(x, y);
+        if (sample.universe != universe) continue;
+        write(sky.sample(sample.direction, map.footprint(x, y)), out + x * 4);
+      }
+      continue;
+    }
+
+    UVBatch batch{};
+    ColorBatch colors{};
+    int columns[gather_width];
+    int count = 0;
+
+    const auto flush = [&]() {
+      /* Pad a partial batch with copies of its first lookup. */
+      for (int i = count; i < gather_width; ++i) {
+        batch.u[i] = batch.u[0];
+        batch.v[i] = batch.v[0];
+        batch.lod[i] = batch.lod[0];
+      }
+      sky.sample_trilinear(batch, colors);
+      for (int i = 0; i < count; ++i) {
+        write({colors.r[i], colors.g[i], colors.b[i], colors.a[i]},
+              out + columns[i] * 4);
+      }
+      count = 0;
+    };
+
+    for (int x = 0; x < map.width(); ++x) {
+      const auto& sample = map.at(x, y);
+      if (sample.universe != universe) continue;
+      const auto uv = equirect_uv(sample.direction);
+      batch.u[count] = static_cast<float>(uv.u);
+      batch.v[count] = static_cast<float>(uv.v);
+      batch.lod[count] = static_cast<float>(sky.level_of_detail(
+          equirect_footprint(sample.direction, map.footprint(x, y))));
+      columns[count] = x;
+      if (++count == gather_width) flush();
+    }
+    if (count > 0) flush();
+  }
+}
+}  // namespace
+
+auto shade(const SkyMap& map, const SkyTexture& upper_sky,
+           const SkyTexture& lower_sky, SkyFilter filter)
+    -> std::vector<unsigned char> {
+  const int width = map.width();
+  std::vector<unsigned char> rgba(static_cast<std::size_t>(width) *
+                                  map.height() * 4);
+  parallel_for(map.height(), [&](auto row) {
+    const int y = static_cast<int>(row);
+    unsigned char* out = rgba.data() + row * width * 4;
+    if (filter == SkyFilter::Ewa) {
+      shade_row_ewa(map, upper_sky, lower_sky, y, out);
+    } else {
+      shade_row_trilinear(map, upper_sky, lower_sky, y, out);
+    }
+  });
+  return rgba;
+}
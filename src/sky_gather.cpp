@@ -0,0 +1,232 @@
+#include "sky_gather.hpp"
+
+#include <algorithm>
+
+#include "detail/simd.hpp"
+#include "srgb.hpp"
+
+namespace {
+using detail::simd::f32x8;
+using detail::simd::i32x8;
+using detail::simd::i64x8;
+
+/* The mip level each lane reads from. All levels share a channel count.
+   For TiledImage levels, slots/tiles_x/tile_bytes/row_stride describe the
+   tiling. */
+struct Lanes {
+  const unsigned char* data[gather_width];
+  i32x8 width;
+  i32x8 height;
+  int channels;
+  bool tiled;
+  const std::uint32_t* slots[gather_width];
+  i32x8 tiles_x;
+  i32x8 tile_bytes;
+  i32x8 row_stride;
+};
+
+struct Texels {
+  f32x8 r;
+  f32x8 g;
+  f32x8 b;
+  f32x8 a;
+};
+
+auto floor_split(const f32x8& x, i32x8& whole, f32x8& fraction) -> void {
+  whole = __builtin_convertvector(x, i32x8);
+  /* Conversion truncates towards zero; comparisons yield -1 per true lane. */
+  whole += __builtin_convertvector(__builtin_convertvector(whole, f32x8) > x,
+                                   i32x8);
+  fraction = x - __builtin_convertvector(whole, f32x8);
+}
+
+/* Read and decode one texel per lane at byte OFFSET. There is no portable
+   gather instruction, so this is the only per-lane loop; everything around it
+   is vectorized. Offsets are 64-bit, as levels may exceed 2 GiB. */
+auto fetch(const Lanes& lanes, const i64x8& offset, Texels& out) -> void {
+  alignas(32) float r[gather_width], g[gather_width], b[gather_width],
+      a[gather_width];
+  switch (lanes.channels) {
+    case 1:
+    case 2:
+      for (int i = 0; i < gather_width; ++i) {
+        const unsigned char* p = lanes.data[i] + offset[i];
+        r[i] = g[i] = b[i] = srgb_to_linear(p[0]);
+        a[i] = lanes.channels == 2 ? alpha_to_float(p[1]) : 1.0f;
+      }
+      break;
+    case 3:
+      for (int i = 0; i < gather_width; ++i) {
+        const unsigned char* p = lanes.data[i] + offset[i];
+        r[i] = srgb_to_linear(p[0]);
+        g[i] = srgb_to_linear(p[1]);
+        b[i] = srgb_to_linear(p[2]);
+        a[i] = 1.0f;
+      }
+      break;
+    default:
+      for (int i = 0; i < gather_width; ++i) {
+        const unsigned char* p = lanes.data[i] + offset[i];
+        r[i] = srgb_to_linear(p[0]);
+        g[i] = srgb_to_linear(p[1]);
+        b[i] = srgb_to_linear(p[2]);
+        a[i] = alpha_to_float(p[3]);
+      }
+      break;
+  }
+  detail::simd::load(out.r, r);
+  detail::simd::load(out.g, g);
+  detail::simd::load(out.b, b);
+  detail::simd::load(out.a, a);
+}
+
+auto lerp(const Texels& p, const Texels& q, const f32x8& t) -> Texels {
+  return {p.r + t * (q.r - p.r), p.g + t * (q.g - p.g), p.b + t * (q.b - p.b),
+          p.a + t * (q.a - p.a)};
+}
+
+auto bilinear(const Lanes& lanes, const f32x8& u, const f32x8& v) -> Texels {
+  const f32x8 width = __builtin_convertvector(lanes.width, f32x8);
+  const f32x8 height = __builtin_convertvector(lanes.height, f32x8);
+  const f32x8 zero{};
+  const f32x8 last_row = height - 1.0f;
+
+  f32x8 y = v * height - 0.5f;
+  y = y < zero ? zero : y;
+  y = y > last_row ? last_row : y;
+
+  i32x8 xi, y0;
+  f32x8 tx, ty;
+  floor_split(u * width - 0.5f, xi, tx);
+  floor_split(y, y0, ty);
+
+  /* Wrap across the dateline. */
+  const i32x8 x0 = ((xi % lanes.width) + lanes.width) % lanes.width;
+  const int c = lanes.channels;
+
+  Texels t00, t10, t01, t11;
+  if (lanes.tiled) {
+    /* The tile padding holds the right and bottom neighbours. */
+    const i32x8 tile =
+        (y0 >> TiledImage::tile_shift) * lanes.tiles_x +
+        (x0 >> TiledImage::tile_shift);
+    i64x8 slot;
+    for (int i = 0; i < gather_width; ++i) slot[i] = lanes.slots[i][tile[i]];
+    /* Only the tile's offset can pass 2 GiB; the one within it is small. */
+    const i64x8 o00 =
+        slot * __builtin_convertvector(lanes.tile_bytes, i64x8) +
+        __builtin_convertvector(
+            (y0 & (TiledImage::tile_size - 1)) * lanes.row_stride +
+                (x0 & (TiledImage::tile_size - 1)) * c,
+            i64x8);
+    const i64x8 row_stride =
+        __builtin_convertvector(lanes.row_stride, i64x8);
+    fetch(lanes, o00, t00);
+    fetch(lanes, o00 + c, t10);
+    fetch(lanes, o00 + row_stride, t01);
+    fetch(lanes, o00 + row_stride + c, t11);
+  } else {
+    /* Clamp at the south pole. */
+    i32x8 x1 = x0 + 1;
+    x1 = x1 >= lanes.width ? x1 - lanes.width : x1;
+    i32x8 y1 = y0 + 1;
+    y1 = y1 >= lanes.height ? lanes.height - 1 : y1;
+
+    const i64x8 width = __builtin_convertvector(lanes.width, i64x8);
+    const i64x8 row0 = __builtin_convertvector(y0, i64x8) * width;
+    const i64x8 row1 = __builtin_convertvector(y1, i64x8) * width;
+    const i64x8 col0 = __builtin_convertvector(x0, i64x8);
+    const i64x8 col1 = __builtin_convertvector(x1, i64x8);
+    fetch(lanes, (row0 + col0) * c, t00);
+    fetch(lanes, (row0 + col1) * c, t10);
+    fetch(lanes, (row1 + col0) * c, t01);
+    fetch(lanes, (row1 + col1) * c, t11);
+  }
+  return lerp(lerp(t00, t10, tx), lerp(t01, t11, tx), ty);
+}
+
+auto store(const Texels& texels, ColorBatch& out) -> void {
+  detail::simd::store(out.r, texels.r);
+  detail::simd::store(out.g, texels.g);
+  detail::simd::store(out.b, texels.b);
+  detail::simd::store(out.a, texels.a);
+}
+auto lanes_at(const std::vector<Image>& levels, const i32x8& level) -> Lanes {
+  Lanes lanes{};
+  lanes.channels = levels.front().channels;
+  for (int i = 0; i < gather_width; ++i) {
+    const auto& image = levels[level[i]];
+    lanes.data[i] = image.data.data();
+    lanes.width[i] = image.width;
+    lanes.height[i] = image.height;
+  }
+  return lanes;
+}
+
+auto lanes_at(const std::vector<TiledImage>& levels, const i32x8& level)
+    -> Lanes {
+  Lanes lanes{};
+  lanes.channels = levels.front().channels;
+  lanes.tiled = true;
+  for (int i = 0; i < gather_width; ++i) {
+    const auto& image = levels[level[i]];
+    lanes.data[i] = image.data.data();
+    lanes.width[i] = image.width;
+    lanes.height[i] = image.height;
+    lanes.slots[i] = image.slots.data();
+    lanes.tiles_x[i] = image.tiles_x;
+    lanes.tile_bytes[i] = static_cast<std::int32_t>(image.tile_bytes());
+    lanes.row_stride[i] = static_cast<std::int32_t>(image.row_stride());
+  }
+  return lanes;
+}
+
+template <typename Levels>
+auto trilinear(const Levels& levels, const UVBatch& uv, ColorBatch& out)
+    -> void {
+  f32x8 u, v, lod;
+  detail::simd::load(u, uv.u);
+  detail::simd::load(v, uv.v);
+  detail::simd::load(lod, uv.lod);
+
+  const f32x8 zero{};
+  const f32x8 last = zero + static_cast<float>(levels.size() - 1);
+  lod = lod < zero ? zero : lod;
+  lod = lod > last ? last : lod;
+
+  i32x8 fine;
+  f32x8 t;
+  floor_split(lod, fine, t);
+  i32x8 coarse = fine + 1;
+  coarse = coarse > __builtin_convertvector(last, i32x8) ? fine : coarse;
+
+  const auto a = bilinear(lanes_at(levels, fine), u, v);
+  const auto b = bilinear(lanes_at(levels, coarse), u, v);
+  store(lerp(a, b, t), out);
+}
+
+}  // namespace
+
+auto gather_bilinear(const Image& image, const UVBatch& uv, ColorBatch& out)
+    -> void {
+  Lanes lanes{};
+  lanes.channels = image.channels;
+  std::fill(std::begin(lanes.data), std::end(lanes.data), image.data.data());
+  lanes.width = i32x8{} + image.width;
+  lanes.height = i32x8{} + image.height;
+
+  f32x8 u, v;
+  detail::simd::load(u, uv.u);
+  detail::simd::load(v, uv.v);
+  store(bilinear(lanes, u, v), out);
+}
+
+auto gather_trilinear(const std::vector<Image>& levels, const UVBatch& uv,
+                      ColorBatch& out) -> void {
+  trilinear(levels, uv, out);
+}
+
+auto gather_trilinear(const std::vector<TiledImage>& levels,
+                      const UVBatch& uv, ColorBatch& out) -> void {
+  trilinear(levels, uv, out);
+}
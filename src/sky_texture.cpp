@@ -0,0 +1,415 @@
+#include "sky_texture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+
+#include "decoded_image.hpp"
+#include "srgb.hpp"
+
+namespace {
+/* Elliptical weighted average filter: Gaussian weights over the ellipse's
+   normalized radius squared, truncated at 1. */
+constexpr int ewa_lut_size = 128;
+constexpr double ewa_alpha = 2.0;
+/* Footprints more eccentric than this get their minor axis lengthened, which
+   bounds the number of texels a single lookup can touch. */
+constexpr double max_anisotropy = 16.0;
+
+const auto ewa_weights = [] {
+  std::array<float, ewa_lut_size> lut{};
+  for (int i = 0; i < ewa_lut_size; ++i) {
+    const double r2 = static_cast<double>(i) / (ewa_lut_size - 1);
+    lut[i] =
+        static_cast<float>(std::exp(-ewa_alpha * r2) - std::exp(-ewa_alpha));
+  }
+  return lut;
+}();
+
+auto wrap(long i, int size) -> int {
+  return static_cast<int>(((i % size) + size) % size);
+}
+
+/* Mip level, out of LEVEL_COUNT, matching the longer axis of FOOTPRINT on a
+   texture whose level 0 is WIDTH x HEIGHT. */
+auto lod_for(int width, int height, std::size_t level_count,
+             const UVFootprint& footprint) -> double {
+  const double extent_x =
+      std::hypot(footprint.du_dx * width, footprint.dv_dx * height);
+  const double extent_y =
+      std::hypot(footprint.du_dy * width, footprint.dv_dy * height);
+  return std::clamp(std::log2(std::max({extent_x, extent_y, 1.0})), 0.0,
+                    static_cast<double>(level_count - 1));
+}
+
+/* Bilinear lookup wrapping in u across the dateline and clamping in v at
+   the poles. */
+auto bilinear_wrapped(const Image& image, SkyUV uv) -> Color {
+  const double x = uv.u * image.width - 0.5;
+  const double y = std::clamp(uv.v * image.height - 0.5, 0.0,
+                              static_cast<double>(image.height - 1));
+  const double fx = std::floor(x);
+  const double fy = std::floor(y);
+  const float tx = static_cast<float>(x - fx);
+  const float ty = static_cast<float>(y - fy);
+
+  const int x0 = wrap(static_cast<long>(fx), image.width);
+  const int x1 = wrap(static_cast<long>(fx) + 1, image.width);
+  const int y0 = static_cast<int>(fy);
+  const int y1 = std::min(y0 + 1, image.height - 1);
+
+  const auto top = lerp(decode_texel(image.texel(x0, y0), image.channels),
+                        decode_texel(image.texel(x1, y0), image.channels), tx);
+  const auto bottom = lerp(decode_texel(image.texel(x0, y1), image.channels),
+                           decode_texel(image.texel(x1, y1), image.channels), tx);
+  return lerp(top, bottom, ty);
+}
+
+/* One level of a VirtualTexture, addressed like a TiledImage. */
+struct VirtualLevel {
+  const VirtualTexture& texture;
+  int level;
+  int width;
+  int height;
+  int channels;
+
+  inline auto texel(int x, int y) const -> const unsigned char* {
+    return texture.texel(level, x, y);
+  }
+  inline auto row_stride() const { return texture.row_stride(); }
+};
+
+auto virtual_level(const VirtualTexture& texture, int level) -> VirtualLevel {
+  const auto& l = texture.levels()[level];
+  return {texture, level, l.width, l.height, texture.channels()};
+}
+
+/* As above on a TiledImage or VirtualLevel: the tile padding supplies the
+   wrapped and clamped neighbours, so all four texels come from one tile. */
+template <typename Tiled>
+auto bilinear_padded(const Tiled& image, SkyUV uv) -> Color {
+  const double x = uv.u * image.width - 0.5;
+  const double y = std::clamp(uv.v * image.height - 0.5, 0.0,
+                              static_cast<double>(image.height - 1));
+  const double fx = std::floor(x);
+  const double fy = std::floor(y);
+  const float tx = static_cast<float>(x - fx);
+  const float ty = static_cast<float>(y - fy);
+
+  const int c = image.channels;
+  const auto stride = image.row_stride();
+  const unsigned char* p =
+      image.texel(wrap(static_cast<long>(fx), image.width),
+                  static_cast<int>(fy));
+  const auto top = lerp(decode_texel(p, c), decode_texel(p + c, c), tx);
+  const auto bottom = lerp(decode_texel(p + stride, c),
+                           decode_texel(p + stride + c, c), tx);
+  return lerp(top, bottom, ty);
+}
+
+/* Elliptical weighted average over IMAGE (an Image, TiledImage or
+   VirtualLevel); calls
+   FALLBACK if the ellipse misses every texel center. */
+template <typename Store, typename Fallback>
+auto ewa_filter(const Store& image, SkyUV uv, double du0, double dv0,
+                double du1, double dv1, const Fallback& fallback) -> Color {
+  const double s = uv.u * image.width - 0.5;
+  const double t = uv.v * image.height - 0.5;
+  du0 *= image.width;
+  du1 *= image.width;
+  dv0 *= image.height;
+  dv1 *= image.height;
+
+  /* Implicit ellipse A s^2 + B s t + C t^2 = 1, grown by a texel so it
+     always covers at least the reconstruction filter's support. */
+  double a = dv0 * dv0 + dv1 * dv1 + 1.0;
+  double b = -2.0 * (du0 * dv0 + du1 * dv1);
+  double c = du0 * du0 + du1 * du1 + 1.0;
+  const double inv_f = 1.0 / (a * c - b * b * 0.25);
+  a *= inv_f;
+  b *= inv_f;
+  c *= inv_f;
+
+  const double det = -b * b + 4.0 * a * c;
+  const double inv_det = 1.0 / det;
+  const double s_radius = 2.0 * inv_det * std::sqrt(det * c);
+  const double t_radius = 2.0 * inv_det * std::sqrt(a * det);
+  const long s0 = static_cast<long>(std::ceil(s - s_radius));
+  const long s1 = static_cast<long>(std::floor(s + s_radius));
+  const long t0 = static_cast<long>(std::ceil(t - t_radius));
+  const long t1 = static_cast<long>(std::floor(t + t_radius));
+
+  Color sum{0.0f, 0.0f, 0.0f, 0.0f};
+  float weight_sum = 0.0f;
+  for (long it = t0; it <= t1; ++it) {
+    const double tt = it - t;
+    const int y = static_cast<int>(std::clamp<long>(it, 0, image.height - 1));
+    for (long is = s0; is <= s1; ++is) {
+      const double ss = is - s;
+      const double r2 = a * ss * ss + b * ss * tt + c * tt * tt;
+      if (r2 >= 1.0) continue;
+      const float w =
+          ewa_weights[std::min(static_cast<int>(r2 * ewa_lut_size),
+                               ewa_lut_size - 1)];
+      const auto texel =
+          decode_texel(image.texel(wrap(is, image.width), y), image.channels);
+      sum.r += w * texel.r;
+      sum.g += w * texel.g;
+      sum.b += w * texel.b;
+      sum.a += w * texel.a;
+      weight_sum += w;
+    }
+  }
+  if (weight_sum <= 0.0f) return fallback();
+  const float inv = 1.0f / weight_sum;
+  return {sum.r * inv, sum.g * inv, sum.b * inv, sum.a * inv};
+}
+
+/* Bilinear lookup clamped on all edges, for cube map faces. */
+auto bilinear_clamped(const Image& image, double s, double t) -> Color {
+  const double x = std::clamp(s * image.width - 0.5, 0.0,
+                              static_cast<double>(image.width - 1));
+  const double y = std::clamp(t * image.height - 0.5, 0.0,
+                              static_cast<double>(image.height - 1));
+  const int x0 = static_cast<int>(x);
+  const int y0 = static_cast<int>(y);
+  const int x1 = std::min(x0 + 1, image.width - 1);
+  const int y1 = std::min(y0 + 1, image.height - 1);
+  const float tx = static_cast<float>(x - x0);
+  const float ty = static_cast<float>(y - y0);
+  const auto texel = [&](int px, int py) {
+    return decode_texel(image.texel(px, py), image.channels);
+  };
+  return lerp(lerp(texel(x0, y0), texel(x1, y0), tx),
+              lerp(texel(x0, y1), texel(x1, y1), tx), ty);
+}
+}  // namespace
+
+auto SkyTexture::from_file(std::string_view file_path, MipFilter filter,
+                           SkyLayout layout) -> std::optional<SkyTexture> {
+  if (file_path.ends_with(".vtex")) {
+    return from_virtual(file_path, default_resident_budget);
+  }
+  /* The cube map is built from level 0 alone; the other layouts take the
+     whole mip chain from the sidecar when it was built with FILTER. */
+  if (layout == SkyLayout::Cubemap) {
+    const auto image = DecodedImage::try_load(file_path);
+    if (!image) return std::nullopt;
+    const auto& base = image->base();
+    return from_pixels(base.width, base.height, base.channels, base.data,
+                       filter, layout);
+  }
+  const auto image = DecodedImage::try_load(file_path, filter);
+  if (!image) return std::nullopt;
+  return from_levels(image->to_images(), layout);
+}
+
+auto SkyTexture::from_pixels(int width, int height, int channels,
+                             const unsigned char* data, MipFilter filter,
+                             SkyLayout layout) -> SkyTexture {
+  SkyTexture t{};
+  t.layout_ = layout;
+  if (layout == SkyLayout::Cubemap) {
+    /* A quarter of the panorama's width keeps the equator's resolution. */
+    auto faces = equirect_to_cubemap(data, width, height, channels,
+                                     std::max(1, width / 4));
+    for (int face = 0; face < cube_faces; ++face) {
+      t.faces_[face] =
+          build_mip_pyramid(std::move(faces[face]), filter, false);
+    }
+    return t;
+  }
+
+  const auto size = static_cast<std::size_t>(width) * height * channels;
+  return from_levels(build_mip_pyramid({.width = width,
+                                        .height = height,
+                                        .channels = channels,
+                                        .data = {data, data + size}},
+                                       filter),
+                     layout);
+}
+
+auto SkyTexture::from_levels(std::vector<Image> levels, SkyLayout layout)
+    -> SkyTexture {
+  SkyTexture t{};
+  t.layout_ = layout;
+  t.levels_ = std::move(levels);
+  if (layout == SkyLayout::TiledEquirect) {
+    for (const auto& level : t.levels_) {
+      t.tiled_levels_.push_back(TiledImage::from_image(level));
+    }
+    t.levels_.clear();
+  }
+  return t;
+}
+
+auto SkyTexture::from_virtual(std::string_view file_path,
+                              std::size_t resident_budget)
+    -> std::optional<SkyTexture> {
+  auto texture = VirtualTexture::open(file_path, resident_budget);
+  if (!texture) return std::nullopt;
+  SkyTexture t{};
+  t.layout_ = SkyLayout::Virtual;
+  t.virtual_ = std::make_shared<VirtualTexture>(std::move(*texture));
+  return t;
+}
+
+auto SkyTexture::end_frame() const -> void {
+  if (virtual_) virtual_->end_frame();
+}
+
+auto SkyTexture::bilinear(int level, SkyUV uv) const -> Color {
+  if (layout_ == SkyLayout::TiledEquirect) {
+    return bilinear_padded(tiled_levels_[level], uv);
+  }
+  if (layout_ == SkyLayout::Virtual) {
+    return bilinear_padded(virtual_level(*virtual_, level), uv);
+  }
+  return bilinear_wrapped(levels_[level], uv);
+}
+
+auto SkyTexture::ewa(int level, SkyUV uv, double du0, double dv0,
+                     double du1, double dv1) const -> Color {
+  const auto fallback = [&]() { return bilinear(level, uv); };
+  if (layout_ == SkyLayout::TiledEquirect) {
+    return ewa_filter(tiled_levels_[level], uv, du0, dv0, du1, dv1, fallback);
+  }
+  if (layout_ == SkyLayout::Virtual) {
+    return ewa_filter(virtual_level(*virtual_, level), uv, du0, dv0, du1, dv1, fallback);
+  }
+  return ewa_filter(levels_[level], uv, du0, dv0, du1, dv1, fallback);
+}
+
+auto SkyTexture::sample(SkyUV uv, const UVFootprint& footprint) const
+    -> Color {
+  const double width = base_width();
+  const double height = base_height();
+  /* Axes of the footprint ellipse, in level 0 texels. */
+  double major_u = footprint.du_dx, major_v = footprint.dv_dx;
+  double minor_u = footprint.du_dy, minor_v = footprint.dv_dy;
+  double major = std::hypot(major_u * width, major_v * height);
+  double minor = std::hypot(minor_u * width, minor_v * height);
+  if (minor > major) {
+    std::swap(major_u, minor_u);
+    std::swap(major_v, minor_v);
+    std::swap(major, minor);
+  }
+  if (major == 0.0) return bilinear(0, uv);
+  if (minor == 0.0) {
+    /* A degenerate footprint, such as one straddling the two universes,
+       has no minor axis to scale: use the perpendicular one of the
+       largest anisotropy allowed. */
+    minor_u = -major_v / max_anisotropy * height / width;
+    minor_v = major_u / max_anisotropy * width / height;
+    minor = major / max_anisotropy;
+  } else if (minor * max_anisotropy < major) {
+    const double scale = major / (minor * max_anisotropy);
+    minor_u *= scale;
+    minor_v *= scale;
+    minor *= scale;
+  }
+
+  const double last = static_cast<double>(level_count() - 1);
+  const double lod = std::clamp(std::log2(std::max(minor, 1.0)), 0.0, last);
+  const int level = static_cast<int>(lod);
+  if (level >= static_cast<int>(last)) return bilinear(level, uv);
+
+  const auto fine = ewa(level, uv, major_u, major_v, minor_u, minor_v);
+  const auto coarse = ewa(level + 1, uv, major_u, major_v, minor_u, minor_v);
+  return lerp(fine, coarse, static_cast<float>(lod - level));
+}
+
+auto SkyTexture::level_of_detail(const UVFootprint& footprint) const
+    -> double {
+  return lod_for(base_width(), base_height(), level_count(), footprint);
+}
+
+auto SkyTexture::sample_trilinear(SkyUV uv, const UVFootprint& footprint) const
+    -> Color {
+  const double lod = level_of_detail(footprint);
+
+  const int level = static_cast<int>(lod);
+  const auto fine = bilinear(level, uv);
+  if (level + 1 >= static_cast<int>(level_count())) return fine;
+  return lerp(fine, bilinear(level + 1, uv), static_cast<float>(lod - level));
+}
+
+auto SkyTexture::sample_trilinear(const UVBatch& uv, ColorBatch& out) const
+    -> void {
+  if (layout_ == SkyLayout::TiledEquirect) {
+    gather_trilinear(tiled_levels_, uv, out);
+  } else if (layout_ == SkyLayout::Virtual) {
+    /* Tiles may not be resident yet, and a page fault costs far more than
+       the gather saves. */
+    const auto last = static_cast<float>(level_count() - 1);
+    for (int i = 0; i < gather_width; ++i) {
+      const float lod = std::clamp(uv.lod[i], 0.0f, last);
+      const int level = static_cast<int>(lod);
+      const SkyUV lane{uv.u[i], uv.v[i]};
+      auto color = bilinear(level, lane);
+      if (level + 1 < static_cast<int>(level_count())) {
+        color = lerp(color, bilinear(level + 1, lane), lod - level);
+      }
+      out.r[i] = color.r;
+      out.g[i] = color.g;
+      out.b[i] = color.b;
+      out.a[i] = color.a;
+    }
+  } else {
+    gather_trilinear(levels_, uv, out);
+  }
+}
+
+auto SkyTexture::level_count() const -> std::size_t {
+  switch (layout_) {
+    case SkyLayout::TiledEquirect:
+      return tiled_levels_.size();
+    case SkyLayout::Virtual:
+      return virtual_->levels().size();
+    default:
+      return levels_.size();
+  }
+}
+
+auto SkyTexture::base_width() const -> int {
+  switch (layout_) {
+    case SkyLayout::TiledEquirect:
+      return tiled_levels_.front().width;
+    case SkyLayout::Virtual:
+      return virtual_->levels().front().width;
+    default:
+      return levels_.front().width;
+  }
+}
+
+auto SkyTexture::base_height() const -> int {
+  switch (layout_) {
+    case SkyLayout::TiledEquirect:
+      return tiled_levels_.front().height;
+    case SkyLayout::Virtual:
+      return virtual_->levels().front().height;
+    default:
+      return levels_.front().height;
+  }
+}
+
+auto SkyTexture::sample_cubemap(Vec3 direction,
+                                const SkyFootprint& footprint) const -> Color {
+  const auto uv = cube_face_uv(direction);
+  const auto& levels = faces_[uv.face];
+  const double lod =
+      lod_for(levels.front().width, levels.front().height, levels.size(),
+              cube_face_footprint(direction, uv.face, footprint));
+  const int level = static_cast<int>(lod);
+  const auto fine = bilinear_clamped(levels[level], uv.s, uv.t);
+  if (level + 1 >= static_cast<int>(levels.size())) return fine;
+  return lerp(fine, bilinear_clamped(levels[level + 1], uv.s, uv.t),
+              static_cast<float>(lod - level));
+}
+
+auto SkyTexture::sample(Vec3 direction, const SkyFootprint& footprint) const
+    -> Color {
+  if (layout_ == SkyLayout::Cubemap) return sample_cubemap(direction, footprint);
+  return sample(equirect_uv(direction), equirect_footprint(direction, footprint));
+}
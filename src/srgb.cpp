@@ -0,0 +1,25 @@
+#include "srgb.hpp"
+
+#include <cmath>
+
+const std::array<float, 256> srgb_to_linear_table = [] {
+  std::array<float, 256> table{};
+  for (int i = 0; i < 256; ++i) {
+    const double c = i / 255.0;
+    table[i] = static_cast<float>(
+        c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+  }
+  return table;
+}();
+
+const std::array<unsigned char, linear_to_srgb_steps> linear_to_srgb_table =
+    [] {
+      std::array<unsigned char, linear_to_srgb_steps> table{};
+      for (int i = 0; i < linear_to_srgb_steps; ++i) {
+        const double l = static_cast<double>(i) / (linear_to_srgb_steps - 1);
+        const double c =
+            l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+        table[i] = static_cast<unsigned char>(c * 255.0 + 0.5);
+      }
+      return table;
+    }();
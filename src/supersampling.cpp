@@ -0,0 +1,92 @@
+#include "supersampling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "sample_sequence.hpp"
+#include "srgb.hpp"
+
+namespace {
+/* How far neighbouring samples may be apart, beyond what the pixel's
+   footprint spans, before the map counts as jumping between them: a factor
+   on the footprint and an angle on the sky in radians. */
+constexpr double jump_factor = 2.0;
+constexpr double jump_slack = 1e-3;
+
+/* Whether the map changes between pixel (X, Y) and its neighbours in a way
+   its footprint doesn't account for. */
+auto discontinuous(const SkyMap& map, int x, int y) -> bool {
+  const auto& center = map.at(x, y);
+  const auto& footprint = map.footprint(x, y);
+  const double reach =
+      jump_factor * std::max(length(footprint.dx), length(footprint.dy)) +
+      jump_slack;
+  const int neighbours[][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for (const auto& [dx, dy] : neighbours) {
+    const int nx = x + dx;
+    const int ny = y + dy;
+    if (nx < 0 || ny < 0 || nx >= map.width() || ny >= map.height()) continue;
+    const auto& neighbour = map.at(nx, ny);
+    if (neighbour.universe != center.universe ||
+        length(neighbour.direction - center.direction) > reach) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+auto supersample_edges(const Camera& camera, const SkyMap& map,
+                       const SkyTexture& upper_sky,
+                       const SkyTexture& lower_sky, int samples_per_pixel,
+                       std::vector<unsigned char>& rgba) -> std::size_t {
+  if (samples_per_pixel <= 1) return 0;
+  const auto& window = map.window();
+  const RayGenerator rays{camera, window.image_width, window.image_height};
+  const double stride = window.stride;
+  /* Each ray covers an equal share of the pixel. */
+  const double share = 1.0 / std::sqrt(static_cast<double>(samples_per_pixel));
+
+  std::atomic<std::size_t> supersampled{0};
+  parallel_for(map.height(), [&](auto row) {
+    const int y = static_cast<int>(row);
+    std::size_t row_supersampled = 0;
+    for (int x = 0; x < map.width(); ++x) {
+      if (!discontinuous(map, x, y)) continue;
+      const auto& footprint = map.footprint(x, y);
+      const SkyFootprint ray_footprint{share * footprint.dx,
+                                       share * footprint.dy};
+      const auto seed = pixel_seed(window.origin_x + x * window.stride,
+                                   window.origin_y + y * window.stride);
+      /* The pixel's corner in image coordinates. */
+      const double left = map.image_x(x) - 0.5 * stride;
+      const double top = map.image_y(y) - 0.5 * stride;
+
+      float sum[4] = {};
+      for (int i = 0; i < samples_per_pixel; ++i) {
+        const auto [u, v] = sobol_2d(static_cast<std::uint32_t>(i), seed);
+        const auto sample = trace(
+            camera, rays.direction(left + u * stride, top + v * stride));
+        const auto& sky =
+            sample.universe == Universe::Upper ? upper_sky : lower_sky;
+        const Color color = sky.sample(sample.direction, ray_footprint);
+        sum[0] += color.r;
+        sum[1] += color.g;
+        sum[2] += color.b;
+        sum[3] += color.a;
+      }
+
+      const float scale = 1.0f / samples_per_pixel;
+      auto* out = &rgba[(row * map.width() + x) * 4];
+      out[0] = linear_to_srgb(sum[0] * scale);
+      out[1] = linear_to_srgb(sum[1] * scale);
+      out[2] = linear_to_srgb(sum[2] * scale);
+      out[3] = float_to_alpha(sum[3] * scale);
+      ++row_supersampled;
+    }
+    supersampled += row_supersampled;
+  });
+  return supersampled;
+}
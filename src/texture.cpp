@@ -1,90 +1,320 @@
 #include "texture.hpp"
 
-#include <stb_image.h>
-
-#include <filesystem>
-#include <functional>
+#include <algorithm>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "cubemap.hpp"
+#include "decoded_image.hpp"
 #include "detail/globject.hpp"
+#include "gl_extensions.hpp"
+#include "ktx2.hpp"
 
-Texture::Texture() { glGenTextures(1, &GLid); }
+namespace {
+/* The GL internal format of FORMAT, if this context can sample it. */
+auto compressed_format(BlockFormat format) -> std::optional<GLenum> {
+  const auto& extensions = gl_extensions();
+  const auto if_supported =
+      [](bool supported, GLenum internal_format) -> std::optional<GLenum> {
+    if (!supported) return std::nullopt;
+    return internal_format;
+  };
+  switch (format) {
+    case BlockFormat::Bc1Rgb:
+      return if_supported(extensions.s3tc, GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+    case BlockFormat::Bc1RgbSrgb:
+      return if_supported(extensions.s3tc, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT);
+    case BlockFormat::Bc3Rgba:
+      return if_supported(extensions.s3tc, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    case BlockFormat::Bc3RgbaSrgb:
+      return if_supported(extensions.s3tc,
+                          GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT);
+    case BlockFormat::Bc7Rgba:
+      return if_supported(extensions.bptc, GL_COMPRESSED_RGBA_BPTC_UNORM);
+    case BlockFormat::Bc7RgbaSrgb:
+      return if_supported(extensions.bptc,
+                          GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+    case BlockFormat::Etc2Rgb:
+      return if_supported(extensions.etc2, GL_COMPRESSED_RGB8_ETC2);
+    case BlockFormat::Etc2RgbSrgb:
+      return if_supported(extensions.etc2, GL_COMPRESSED_SRGB8_ETC2);
+    case BlockFormat::Etc2Rgba:
+      return if_supported(extensions.etc2, GL_COMPRESSED_RGBA8_ETC2_EAC);
+    case BlockFormat::Etc2RgbaSrgb:
+      return if_supported(extensions.etc2,
+                          GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+  }
+  return std::nullopt;
+}
 
-auto Texture::from_file(std::string_view file_path) -> Texture {
-  if (!std::filesystem::exists(file_path)) {
-    std::cerr << "[ERROR]: Texture image does not exist (" << file_path
-              << ")\n";
-    std::exit(-1);
+auto has_alpha(BlockFormat format) -> bool {
+  switch (format) {
+    case BlockFormat::Bc1Rgb:
+    case BlockFormat::Bc1RgbSrgb:
+    case BlockFormat::Etc2Rgb:
+    case BlockFormat::Etc2RgbSrgb:
+      return false;
+    default:
+      return true;
   }
+}
+}  // namespace
+
+Texture::Texture() { glGenTextures(1, &GLid); }
+
+auto Texture::from_file(std::string_view file_path, TextureTarget target)
+    -> Texture {
+  if (file_path.ends_with(".ktx2")) return from_ktx2(file_path, target);
+
+  /* Maps the decoded sidecar instead of decoding when it is up to date. */
+  const auto image = DecodedImage::load(file_path);
+  const unsigned char* data = image.base().data;
   Texture t{};
-  unsigned char* data =
-      stbi_load(file_path.data(), &t.width_, &t.height_, &t.nr_channels_, 0);
+  t.width_ = image.base().width;
+  t.height_ = image.base().height;
+  t.nr_channels_ = image.base().channels;
 
-  if (!data) {
-    std::cerr << "Failed to load texture image (" << file_path << ")\n";
-    std::exit(-1);
-  }
+  const auto format = format_for(t.nr_channels_, file_path);
+
+  /* Rows of 3-channel images aren't necessarily 4-byte aligned. */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  if (target == TextureTarget::CubeMap) {
+    /* A quarter of the panorama's width keeps the equator's resolution. */
+    const int face_size = std::max(1, t.width_ / 4);
+    const auto faces = equirect_to_cubemap(data, t.width_, t.height_,
+                                           t.nr_channels_, face_size);
 
-  const auto format = std::invoke([&]() {
-    switch (t.nr_channels_) {
-      case 1:
-        return GL_RED;
-      case 3:
-        return GL_RGB;
-      case 4:
-        return GL_RGBA;
-      default:
-        std::cerr << "[ERROR]: Texture image format not supported ("
-                  << file_path << ")\n";
-        std::exit(-1);
+    t.target_ = GL_TEXTURE_CUBE_MAP;
+    t.width_ = t.height_ = face_size;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, t.GLid);
+    set_sampling(GL_TEXTURE_CUBE_MAP);
+    for (int face = 0; face < cube_faces; ++face) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, format, face_size,
+                   face_size, 0, format, GL_UNSIGNED_BYTE,
+                   faces[face].data.data());
     }
-  });
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    return t;
+  }
 
   /* Bind and load texture. */
   glBindTexture(GL_TEXTURE_2D, t.GLid);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  set_sampling(GL_TEXTURE_2D);
 
   glTexImage2D(GL_TEXTURE_2D, 0, format, t.width_, t.height_, 0, format,
                GL_UNSIGNED_BYTE, data);
   glGenerateMipmap(GL_TEXTURE_2D);
 
-  stbi_image_free(data);
+  return t;
+}
+
+auto Texture::from_ktx2(std::string_view file_path, TextureTarget target)
+    -> Texture {
+  const auto file = Ktx2Texture::open(file_path);
+  const auto format = compressed_format(file.format());
+  if (!format) {
+    std::cerr << "[ERROR]: Compressed texture format not supported by the "
+                 "GL driver ("
+              << file_path << ")\n";
+    std::exit(-1);
+  }
+  const bool cube = file.faces() == cube_faces;
+  if (cube != (target == TextureTarget::CubeMap)) {
+    std::cerr << "[ERROR]: Compressed texture is not a "
+              << (cube ? "2D texture" : "cube map") << " (" << file_path
+              << ")\n";
+    std::exit(-1);
+  }
+
+  Texture t{};
+  t.target_ = cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+  t.width_ = file.levels().front().width;
+  t.height_ = file.levels().front().height;
+  t.nr_channels_ = has_alpha(file.format()) ? 4 : 3;
 
+  /* The stored chain replaces glGenerateMipmap, which can't run on
+     compressed data; the data goes straight from the mapping. */
+  glBindTexture(t.target_, t.GLid);
+  set_sampling(t.target_);
+  const auto& levels = file.levels();
+  glTexParameteri(t.target_, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(levels.size()) - 1);
+  for (std::size_t i = 0; i < levels.size(); ++i) {
+    const auto& level = levels[i];
+    for (int face = 0; face < file.faces(); ++face) {
+      const GLenum face_target =
+          cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+      glCompressedTexImage2D(face_target, static_cast<GLint>(i), *format,
+                             level.width, level.height, 0,
+                             static_cast<GLsizei>(level.face_size),
+                             level.data + face * level.face_size);
+    }
+  }
   return t;
 }
 
-static auto translate(int texture_unit) -> GLenum {
-  switch (texture_unit) {
-    case 0:
-      return GL_TEXTURE0;
+auto Texture::format_for(int channels, std::string_view file_path)
+    -> GLenum {
+  switch (channels) {
     case 1:
-      return GL_TEXTURE1;
-    case 2:
-      return GL_TEXTURE2;
+      return GL_RED;
     case 3:
-      return GL_TEXTURE3;
+      return GL_RGB;
     case 4:
-      return GL_TEXTURE4;
-    case 5:
-      return GL_TEXTURE5;
-    case 6:
-      return GL_TEXTURE6;
-    case 7:
-      return GL_TEXTURE7;
-    case 8:
-      return GL_TEXTURE8;
-    case 9:
-      return GL_TEXTURE9;
+      return GL_RGBA;
     default:
-      throw std::out_of_range("Texture unit index out of range [0, 9]");
+      std::cerr << "[ERROR]: Texture image format not supported ("
+                << file_path << ")\n";
+      std::exit(-1);
+  }
+}
+
+auto Texture::set_sampling(GLenum target) -> void {
+  if (target == GL_TEXTURE_CUBE_MAP) {
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return;
   }
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+auto Texture::translate(int texture_unit) -> GLenum {
+  static const GLint max_units = [] {
+    GLint units = 0;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &units);
+    return units;
+  }();
+  if (texture_unit < 0 || texture_unit >= max_units) {
+    throw std::out_of_range("Texture unit index out of range [0, " +
+                            std::to_string(max_units - 1) + "]");
+  }
+  return GL_TEXTURE0 + static_cast<GLenum>(texture_unit);
+}
+
+auto Texture::allocate(int width, int height, int channels) -> void {
+  width_ = width;
+  height_ = height;
+  nr_channels_ = channels;
+  target_ = GL_TEXTURE_2D;
+  const auto format = format_for(channels, "texture allocation");
+  if (texture_unit_ >= 0) glActiveTexture(translate(texture_unit_));
+  glBindTexture(GL_TEXTURE_2D, GLid);
+  set_sampling(GL_TEXTURE_2D);
+  /* Allocated textures hold rendered frames, which are stretched over the
+     window; repeating would bleed each edge into the opposite one. */
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  const std::vector<unsigned char> zeros(
+      static_cast<std::size_t>(width) * height * channels);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
+               GL_UNSIGNED_BYTE, zeros.data());
+}
+
+auto Texture::update(int x, int y, int width, int height,
+                     const unsigned char* data) -> void {
+  if (texture_unit_ >= 0) glActiveTexture(translate(texture_unit_));
+  glBindTexture(GL_TEXTURE_2D, GLid);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                  format_for(nr_channels_, "texture update"), GL_UNSIGNED_BYTE,
+                  data);
 }
 
 auto Texture::bind(int texture_unit) -> void {
   glActiveTexture(translate(texture_unit));
-  glBindTexture(GL_TEXTURE_2D, GLid);
+  glBindTexture(target_, GLid);
+  texture_unit_ = texture_unit;
+}
+
+TextureArray::TextureArray(int width, int height, int channels, int layers)
+    : width_{width},
+      height_{height},
+      nr_channels_{channels},
+      layers_{layers},
+      format_{Texture::format_for(channels, "texture array")} {
+  GLint max_layers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  if (layers < 1 || layers > max_layers) {
+    std::cerr << "[ERROR]: Texture array needs " << layers
+              << " layers, the driver allows " << max_layers << "\n";
+    std::exit(-1);
+  }
+
+  glGenTextures(1, &GLid);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, GLid);
+  Texture::set_sampling(GL_TEXTURE_2D_ARRAY);
+  /* Every level is allocated up front, so generating mipmaps later never
+     respecifies the texture, which a bindless handle forbids; sample them
+     too. */
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  for (int level = 0, w = width, h = height;; ++level) {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format_, w, h, layers, 0,
+                 format_, GL_UNSIGNED_BYTE, nullptr);
+    if (w == 1 && h == 1) break;
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+
+  const auto& extensions = gl_extensions();
+  if (extensions.get_texture_handle) {
+    handle_ = extensions.get_texture_handle(GLid);
+    extensions.make_texture_handle_resident(handle_);
+  }
+}
+
+auto TextureArray::from_files(const std::vector<std::string>& file_paths)
+    -> TextureArray {
+  if (file_paths.empty()) {
+    std::cerr << "[ERROR]: Texture array needs at least one image\n";
+    std::exit(-1);
+  }
+  const auto first = DecodedImage::load(file_paths.front());
+  TextureArray t{first.base().width, first.base().height,
+                 first.base().channels, static_cast<int>(file_paths.size())};
+  t.set_layer(0, first.base());
+  for (std::size_t i = 1; i < file_paths.size(); ++i) {
+    const auto image = DecodedImage::load(file_paths[i]);
+    const auto& base = image.base();
+    if (base.width != t.width_ || base.height != t.height_ ||
+        base.channels != t.nr_channels_) {
+      std::cerr << "[ERROR]: Texture array layers must match in size and "
+                   "channels ("
+                << file_paths[i] << ")\n";
+      std::exit(-1);
+    }
+    t.set_layer(static_cast<int>(i), base);
+  }
+  t.generate_mipmaps();
+  return t;
+}
+
+auto TextureArray::set_layer(int layer, const ImageView& image) -> void {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, GLid);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width_, height_, 1,
+                  format_, GL_UNSIGNED_BYTE, image.data);
+}
+
+auto TextureArray::generate_mipmaps() -> void {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, GLid);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+auto TextureArray::bind(int texture_unit) -> void {
+  glActiveTexture(Texture::translate(texture_unit));
+  glBindTexture(GL_TEXTURE_2D_ARRAY, GLid);
   texture_unit_ = texture_unit;
 }
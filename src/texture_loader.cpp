@@ -0,0 +1,339 @@
+#include "texture_loader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+
+#include "cubemap.hpp"
+#include "decoded_image.hpp"
+#include "gl_extensions.hpp"
+
+namespace {
+/* The bindings update disturbs, restored before it returns so the render
+   loop's state is untouched. */
+struct SavedBindings {
+  GLint active_unit;
+  GLint texture_2d;
+  GLint cube_map;
+  GLint unpack_buffer;
+};
+
+auto save_bindings() -> SavedBindings {
+  SavedBindings saved{};
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &saved.active_unit);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &saved.texture_2d);
+  glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &saved.cube_map);
+  glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &saved.unpack_buffer);
+  return saved;
+}
+
+auto restore_bindings(const SavedBindings& saved) -> void {
+  glActiveTexture(static_cast<GLenum>(saved.active_unit));
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(saved.texture_2d));
+  glBindTexture(GL_TEXTURE_CUBE_MAP, static_cast<GLuint>(saved.cube_map));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,
+               static_cast<GLuint>(saved.unpack_buffer));
+}
+
+/* Whether FENCE has passed, without waiting for it. Flushes so a fence
+   polled before the next buffer swap still gets there. */
+auto signaled(GLsync fence) -> bool {
+  const auto status =
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+}  // namespace
+
+struct TextureLoader::Job {
+  std::string path;
+  TextureTarget target;
+  std::shared_ptr<Texture> texture;
+  /* Whether this uploads the thumbnail shown until the full image lands. */
+  bool proxy{false};
+
+  /* Filled in by a decode worker. SURFACES holds the rows of each face (a
+     single one for Texture2D), pointing into IMAGE or FACES. */
+  std::optional<DecodedImage> image;
+  std::array<Image, cube_faces> faces;
+  std::vector<const unsigned char*> surfaces;
+  int width{0};
+  int height{0};
+  int channels{0};
+
+  /* Upload progress, on the GL thread. */
+  GLuint staging{0};
+  GLenum gl_target{GL_TEXTURE_2D};
+  GLenum format{GL_RGB};
+  std::size_t surface{0};
+  int row{0};
+  GLsync done{nullptr};
+};
+
+TextureLoader::TextureLoader(TextureLoaderOptions options)
+    : options_{options} {
+  const auto ring_size =
+      static_cast<GLsizeiptr>(ring_segments * segment_bytes);
+  glGenBuffers(1, &ring_);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_);
+  if (const auto buffer_storage = gl_extensions().buffer_storage) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    buffer_storage(GL_PIXEL_UNPACK_BUFFER, ring_size, nullptr, flags);
+    ring_memory_ = static_cast<unsigned char*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ring_size, flags));
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, ring_size, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  for (int i = 0; i < std::max(1, options_.decode_threads); ++i) {
+    workers_.emplace_back([this](std::stop_token stop) { decode_loop(stop); });
+  }
+}
+
+TextureLoader::~TextureLoader() {
+  workers_.clear();
+  for (const auto& job : uploading_) {
+    if (job->done) glDeleteSync(job->done);
+    if (job->staging) glDeleteTextures(1, &job->staging);
+  }
+  for (const auto fence : ring_fences_) {
+    if (fence) glDeleteSync(fence);
+  }
+  if (ring_memory_) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &ring_);
+}
+
+auto TextureLoader::load(std::string_view file_path, TextureTarget target)
+    -> std::shared_ptr<Texture> {
+  /* Compressed files need no decode and upload a fraction of the bytes,
+     straight from the mapping. */
+  if (file_path.ends_with(".ktx2")) {
+    const auto saved = save_bindings();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    auto texture =
+        std::make_shared<Texture>(Texture::from_file(file_path, target));
+    restore_bindings(saved);
+    return texture;
+  }
+
+  auto texture = std::make_shared<Texture>();
+  const unsigned char grey[] = {128, 128, 128};
+  const auto saved = save_bindings();
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (target == TextureTarget::CubeMap) {
+    texture->target_ = GL_TEXTURE_CUBE_MAP;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture->GLid);
+    Texture::set_sampling(GL_TEXTURE_CUBE_MAP);
+    for (int face = 0; face < cube_faces; ++face) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, 1, 1, 0,
+                   GL_RGB, GL_UNSIGNED_BYTE, grey);
+    }
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, texture->GLid);
+    Texture::set_sampling(GL_TEXTURE_2D);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 grey);
+  }
+  restore_bindings(saved);
+  texture->width_ = texture->height_ = 1;
+  texture->nr_channels_ = 3;
+
+  auto job = std::make_unique<Job>();
+  job->path = std::string{file_path};
+  job->target = target;
+  job->texture = texture;
+  {
+    std::lock_guard lock{mutex_};
+    queued_.push_back(std::move(job));
+  }
+  queued_cv_.notify_one();
+  ++pending_;
+  return texture;
+}
+
+auto TextureLoader::decode_loop(std::stop_token stop) -> void {
+  for (;;) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock lock{mutex_};
+      if (!queued_cv_.wait(lock, stop, [&] { return !queued_.empty(); })) {
+        return;
+      }
+      job = std::move(queued_.front());
+      queued_.pop_front();
+    }
+
+    if (options_.proxies) {
+      if (auto thumbnail = DecodedImage::load_proxy(job->path)) {
+        auto proxy = std::make_unique<Job>();
+        proxy->path = job->path;
+        proxy->target = job->target;
+        proxy->texture = job->texture;
+        proxy->proxy = true;
+        prepare(*proxy, std::move(*thumbnail));
+        std::lock_guard lock{mutex_};
+        decoded_.push_back(std::move(proxy));
+      }
+    }
+    prepare(*job, DecodedImage::load(job->path));
+
+    std::lock_guard lock{mutex_};
+    decoded_.push_back(std::move(job));
+  }
+}
+
+auto TextureLoader::prepare(Job& job, DecodedImage image) -> void {
+  const auto& base = image.base();
+  job.channels = base.channels;
+  if (job.target == TextureTarget::CubeMap) {
+    /* A quarter of the panorama's width keeps the equator's resolution. */
+    const int face_size = std::max(1, base.width / 4);
+    job.faces = equirect_to_cubemap(base.data, base.width, base.height,
+                                    base.channels, face_size);
+    job.width = job.height = face_size;
+    for (const auto& face : job.faces) {
+      job.surfaces.push_back(face.data.data());
+    }
+  } else {
+    job.width = base.width;
+    job.height = base.height;
+    job.surfaces.push_back(base.data);
+    job.image = std::move(image);
+  }
+}
+
+auto TextureLoader::start_upload(Job& job) -> void {
+  job.format = Texture::format_for(job.channels, job.path);
+  job.gl_target = job.target == TextureTarget::CubeMap ? GL_TEXTURE_CUBE_MAP
+                                                       : GL_TEXTURE_2D;
+  glGenTextures(1, &job.staging);
+  glBindTexture(job.gl_target, job.staging);
+  Texture::set_sampling(job.gl_target);
+  for (std::size_t i = 0; i < job.surfaces.size(); ++i) {
+    const GLenum target = job.gl_target == GL_TEXTURE_CUBE_MAP
+                              ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+                              : GL_TEXTURE_2D;
+    glTexImage2D(target, 0, job.format, job.width, job.height, 0, job.format,
+                 GL_UNSIGNED_BYTE, nullptr);
+  }
+}
+
+auto TextureLoader::upload_chunk(Job& job) -> std::size_t {
+  /* The GPU may still be reading the segment's previous chunk. */
+  auto& fence = ring_fences_[next_segment_];
+  if (fence) {
+    if (!signaled(fence)) return 0;
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  const auto row_bytes = static_cast<std::size_t>(job.width) * job.channels;
+  const int rows = std::min(
+      job.height - job.row,
+      std::max(1, static_cast<int>(segment_bytes / row_bytes)));
+  const auto bytes = static_cast<std::size_t>(rows) * row_bytes;
+  const auto offset = next_segment_ * segment_bytes;
+  const unsigned char* source =
+      job.surfaces[job.surface] + static_cast<std::size_t>(job.row) * row_bytes;
+
+  if (ring_memory_) {
+    std::memcpy(ring_memory_ + offset, source, bytes);
+  } else {
+    /* The fence above already guarantees the GPU is done with the range. */
+    auto* memory = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, static_cast<GLintptr>(offset),
+        static_cast<GLsizeiptr>(bytes),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+    std::memcpy(memory, source, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  const GLenum target =
+      job.gl_target == GL_TEXTURE_CUBE_MAP
+          ? static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + job.surface)
+          : GL_TEXTURE_2D;
+  glBindTexture(job.gl_target, job.staging);
+  glTexSubImage2D(target, 0, 0, job.row, job.width, rows, job.format,
+                  GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  next_segment_ = (next_segment_ + 1) % ring_segments;
+
+  job.row += rows;
+  if (job.row == job.height) {
+    job.row = 0;
+    ++job.surface;
+  }
+  if (job.surface == job.surfaces.size()) {
+    glGenerateMipmap(job.gl_target);
+    job.done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    /* Every row now lives in the ring or the texture. */
+    job.image.reset();
+    job.faces = {};
+    job.surfaces.clear();
+  }
+  return bytes;
+}
+
+auto TextureLoader::update() -> void {
+  const auto saved = save_bindings();
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  {
+    std::lock_guard lock{mutex_};
+    while (!decoded_.empty()) {
+      start_upload(*decoded_.front());
+      uploading_.push_back(std::move(decoded_.front()));
+      decoded_.pop_front();
+    }
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_);
+  std::size_t budget = options_.upload_bytes_per_frame;
+  for (const auto& job : uploading_) {
+    while (budget > 0 && !job->done) {
+      const auto bytes = upload_chunk(*job);
+      if (bytes == 0) {
+        budget = 0;
+        break;
+      }
+      budget -= std::min(bytes, budget);
+    }
+  }
+  restore_bindings(saved);
+
+  for (auto it = uploading_.begin(); it != uploading_.end();) {
+    auto& job = **it;
+    if (!job.done || !signaled(job.done)) {
+      ++it;
+      continue;
+    }
+    glDeleteSync(job.done);
+
+    auto& texture = *job.texture;
+    glDeleteTextures(1, &texture.GLid);
+    texture.GLid = job.staging;
+    texture.target_ = job.gl_target;
+    texture.width_ = job.width;
+    texture.height_ = job.height;
+    texture.nr_channels_ = job.channels;
+    if (texture.texture_unit_ >= 0) {
+      GLint active_unit;
+      glGetIntegerv(GL_ACTIVE_TEXTURE, &active_unit);
+      glActiveTexture(GL_TEXTURE0 + texture.texture_unit_);
+      glBindTexture(texture.target_, texture.GLid);
+      glActiveTexture(static_cast<GLenum>(active_unit));
+    }
+
+    if (!job.proxy) --pending_;
+    it = uploading_.erase(it);
+  }
+}
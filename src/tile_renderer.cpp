@@ -0,0 +1,334 @@
+#include "tile_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "parallel.hpp"
+#include "ray_differentials.hpp"
+#include "reprojection.hpp"
+#include "supersampling.hpp"
+
+namespace {
+/* Offsets within each pass_stride x pass_stride block traced by the
+   progressive passes, in pass order: a 4x4 ordered dither, so every pass
+   spreads its samples evenly between those of the passes before it. */
+constexpr int pass_stride = 4;
+constexpr int pass_count = pass_stride * pass_stride;
+/* A reprojected frame that had to trace more than this share of its pixels
+   has strayed far from the last full trace: it is traced in full again, so
+   later frames reproject from closer by. */
+constexpr double retrace_share = 0.25;
+constexpr std::pair<int, int> pass_offsets[pass_count] = {
+    {1, 1}, {3, 3}, {3, 1}, {1, 3}, {2, 2}, {0, 0}, {0, 2}, {2, 0},
+    {2, 1}, {0, 3}, {0, 1}, {2, 3}, {1, 2}, {3, 0}, {3, 2}, {1, 0}};
+}  // namespace
+
+TileRenderer::TileRenderer(const SkyTexture& upper_sky,
+                           const SkyTexture& lower_sky,
+                           TileRendererOptions options)
+    : upper_sky_{upper_sky},
+      lower_sky_{lower_sky},
+      options_{options},
+      sampler_{options.sampling},
+      worker_{[this](std::stop_token stop) { render_loop(stop); }} {}
+
+auto TileRenderer::render(const Camera& camera, int width, int height)
+    -> void {
+  const int size = std::max(1, options_.tile_size);
+  const auto generation = generation_.load(std::memory_order_relaxed) + 1;
+  /* Bumped before the request is published, so the worker can't take the
+     new frame while it still looks superseded and drop it. */
+  generation_.store(generation, std::memory_order_release);
+  requests_.back() = {.camera = camera,
+                      .width = width,
+                      .height = height,
+                      .generation = generation};
+  requests_.publish();
+  /* Progressive renders end with a pass filtering every pixel over its own
+     footprint. */
+  remaining_ = options_.progressive
+                   ? pass_count + 1
+                   : static_cast<std::size_t>((width + size - 1) / size) *
+                         ((height + size - 1) / size);
+  wake_worker();
+}
+
+auto TileRenderer::finished_tiles() -> std::vector<RenderedTile> {
+  const auto generation = generation_.load(std::memory_order_acquire);
+  std::vector<RenderedTile> tiles;
+  if (options_.progressive) {
+    /* A pass covers the whole frame, so only the latest matters, and one of
+       a superseded frame still beats showing nothing new. */
+    if (passes_.take()) {
+      auto& result = passes_.front();
+      current_ = result.generation == generation;
+      if (current_) remaining_ = result.remaining;
+      tiles.push_back(std::move(result.tile));
+    }
+    return tiles;
+  }
+
+  std::lock_guard lock{mutex_};
+  for (auto& result : finished_) {
+    if (result.generation != generation) continue;
+    tiles.push_back(std::move(result.tile));
+    --remaining_;
+  }
+  finished_.clear();
+  return tiles;
+}
+
+auto TileRenderer::done() -> bool { return remaining_ == 0; }
+
+auto TileRenderer::wake_worker() -> void {
+  wakeups_.fetch_add(1, std::memory_order_release);
+  wakeups_.notify_one();
+}
+
+auto TileRenderer::render_loop(std::stop_token stop) -> void {
+  std::stop_callback wake_on_stop{stop, [this] { wake_worker(); }};
+  for (;;) {
+    /* Read before looking for work, so a request or stop arriving after the
+       look changes it and the wait returns at once. */
+    const auto wakeups = wakeups_.load(std::memory_order_acquire);
+    if (stop.stop_requested()) return;
+    if (!requests_.take()) {
+      wakeups_.wait(wakeups, std::memory_order_acquire);
+      continue;
+    }
+    const Frame frame = requests_.front();
+    if (options_.progressive) {
+      render_passes(frame, stop);
+    } else {
+      render_tiles(frame, stop);
+    }
+    end_sky_frame();
+  }
+}
+
+auto TileRenderer::end_sky_frame() const -> void {
+  upper_sky_.end_frame();
+  /* The universes may share one sky, whose frame must only end once. */
+  if (&lower_sky_ != &upper_sky_) lower_sky_.end_frame();
+}
+
+auto TileRenderer::cancelled(const Frame& frame,
+                             const std::stop_token& stop) const -> bool {
+  return stop.stop_requested() ||
+         frame.generation != generation_.load(std::memory_order_acquire);
+}
+
+auto TileRenderer::render_tiles(const Frame& frame,
+                                const std::stop_token& stop) -> void {
+  /* Center-out, so the middle of the view, where the throat usually is,
+     shows up first. */
+  const int size = std::max(1, options_.tile_size);
+  std::vector<std::pair<int, int>> tiles;
+  for (int y = 0; y < frame.height; y += size) {
+    for (int x = 0; x < frame.width; x += size) tiles.emplace_back(x, y);
+  }
+  const auto distance = [&](const std::pair<int, int>& tile) {
+    const double dx = tile.first + 0.5 * size - 0.5 * frame.width;
+    const double dy = tile.second + 0.5 * size - 0.5 * frame.height;
+    return dx * dx + dy * dy;
+  };
+  std::stable_sort(tiles.begin(), tiles.end(),
+                   [&](const auto& a, const auto& b) {
+                     return distance(a) < distance(b);
+                   });
+
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    if (cancelled(frame, stop)) return;
+    const auto [x, y] = tiles[i];
+    auto tile = render_tile(frame, x, y, std::min(size, frame.width - x),
+                            std::min(size, frame.height - y));
+    {
+      std::lock_guard lock{mutex_};
+      finished_.push_back({.generation = frame.generation,
+                           .remaining = tiles.size() - i - 1,
+                           .tile = std::move(tile)});
+    }
+    if (options_.on_ready) options_.on_ready();
+  }
+}
+
+auto TileRenderer::render_passes(const Frame& frame,
+                                 const std::stop_token& stop) -> void {
+  const int width = frame.width;
+  const int height = frame.height;
+  const auto pixels = static_cast<std::size_t>(width) * height;
+  /* Every pixel's sample and color once its pass has run. */
+  SkyMap map{width, height};
+  std::vector<unsigned char> colors(pixels * 4);
+  std::vector<unsigned char> rgba(pixels * 4);
+
+  /* Always from the last frame traced in full: reprojecting a reprojected
+     map would resample it again every frame, piling up blur and error while
+     the camera keeps moving. */
+  bool reprojected = false;
+  if (traced_map_.width() > 0) {
+    SkyMap reused{width, height};
+    if (const auto stats =
+            reproject(traced_camera_, traced_map_, frame.camera, reused)) {
+      /* Reused samples are as close as the sampler's own interpolation, so
+         the frame is final unless the last full trace is getting stale. */
+      const bool stale = static_cast<double>(stats->traced) >
+                         retrace_share * static_cast<double>(pixels);
+      compute_differentials(frame.camera, reused);
+      auto reused_rgba = shade(reused, upper_sky_, lower_sky_,
+                               options_.filter);
+      if (!stale) {
+        supersample_edges(frame.camera, reused, upper_sky_, lower_sky_,
+                          options_.samples_per_pixel, reused_rgba);
+      }
+      if (cancelled(frame, stop)) return;
+      publish_pass(frame, stale ? 1 : 0,
+                   {.x = 0,
+                    .y = 0,
+                    .width = width,
+                    .height = height,
+                    .rgba = std::move(reused_rgba)});
+      if (!stale) return;
+      reprojected = true;
+    }
+  }
+
+  for (int pass = 0; pass < pass_count; ++pass) {
+    if (cancelled(frame, stop)) return;
+    const auto [ox, oy] = pass_offsets[pass];
+    const int pass_width = (width - ox + pass_stride - 1) / pass_stride;
+    const int pass_height = (height - oy + pass_stride - 1) / pass_stride;
+    if (pass_width <= 0 || pass_height <= 0) continue;
+
+    SkyMap pass_map{pass_width, pass_height,
+                    {.image_width = width,
+                     .image_height = height,
+                     .origin_x = ox,
+                     .origin_y = oy,
+                     .stride = pass_stride}};
+    sampler_.sample(frame.camera, pass_map);
+    for (int y = 0; y < pass_height; ++y) {
+      for (int x = 0; x < pass_width; ++x) {
+        map.at(ox + x * pass_stride, oy + y * pass_stride) = pass_map.at(x, y);
+      }
+    }
+    /* The reprojected frame is better than any pass but the last. */
+    if (reprojected) continue;
+
+    compute_differentials(frame.camera, pass_map);
+    /* The footprints span pass_stride pixels; shrink them to the spacing of
+       the samples traced so far, pass_stride / sqrt(pass + 1). */
+    const double scale = 1.0 / std::sqrt(pass + 1.0);
+    for (int y = 0; y < pass_height; ++y) {
+      for (int x = 0; x < pass_width; ++x) {
+        auto& footprint = pass_map.footprint(x, y);
+        footprint = {scale * footprint.dx, scale * footprint.dy};
+      }
+    }
+    const auto pass_rgba =
+        shade(pass_map, upper_sky_, lower_sky_, options_.filter);
+    for (int y = 0; y < pass_height; ++y) {
+      for (int x = 0; x < pass_width; ++x) {
+        const int px = ox + x * pass_stride;
+        const int py = oy + y * pass_stride;
+        std::memcpy(
+            &colors[(static_cast<std::size_t>(py) * width + px) * 4],
+            &pass_rgba[(static_cast<std::size_t>(y) * pass_width + x) * 4], 4);
+      }
+    }
+
+    /* Every pixel shows the nearest sample traced so far in its block, or
+       in the blocks before it where the image border cuts its block off
+       before any. */
+    parallel_for(height, [&](auto row) {
+      const int y = static_cast<int>(row);
+      for (int x = 0; x < width; ++x) {
+        std::size_t best = 0;
+        int best_distance = std::numeric_limits<int>::max();
+        for (const int back : {0, pass_stride}) {
+          const int bx = std::max(0, x - x % pass_stride - back);
+          const int by = std::max(0, y - y % pass_stride - back);
+          for (int traced = 0; traced <= pass; ++traced) {
+            const int sx = bx + pass_offsets[traced].first;
+            const int sy = by + pass_offsets[traced].second;
+            if (sx >= width || sy >= height) continue;
+            const int distance = (sx - x) * (sx - x) + (sy - y) * (sy - y);
+            if (distance < best_distance) {
+              best = (static_cast<std::size_t>(sy) * width + sx) * 4;
+              best_distance = distance;
+            }
+          }
+          if (best_distance != std::numeric_limits<int>::max()) break;
+        }
+        std::memcpy(&rgba[(row * width + x) * 4], &colors[best], 4);
+      }
+    });
+    publish_pass(frame, pass_count - pass,
+                 {.x = 0,
+                  .y = 0,
+                  .width = width,
+                  .height = height,
+                  .rgba = rgba});
+  }
+
+  /* All pixels are traced: filter each over its own footprint, and
+     supersample the edges the footprints can't filter. */
+  if (cancelled(frame, stop)) return;
+  compute_differentials(frame.camera, map);
+  rgba = shade(map, upper_sky_, lower_sky_, options_.filter);
+  supersample_edges(frame.camera, map, upper_sky_, lower_sky_,
+                    options_.samples_per_pixel, rgba);
+  if (cancelled(frame, stop)) return;
+  publish_pass(frame, 0,
+               {.x = 0,
+                .y = 0,
+                .width = width,
+                .height = height,
+                .rgba = std::move(rgba)});
+  traced_camera_ = frame.camera;
+  traced_map_ = std::move(map);
+}
+
+auto TileRenderer::publish_pass(const Frame& frame, std::size_t remaining,
+                                RenderedTile tile) -> void {
+  passes_.back() = {.generation = frame.generation,
+                    .remaining = remaining,
+                    .tile = std::move(tile)};
+  passes_.publish();
+  if (options_.on_ready) options_.on_ready();
+}
+
+auto TileRenderer::render_tile(const Frame& frame, int x, int y, int width,
+                               int height) const -> RenderedTile {
+  /* One pixel of apron on every side that isn't the image border. */
+  const int x0 = std::max(0, x - 1);
+  const int y0 = std::max(0, y - 1);
+  const int x1 = std::min(frame.width, x + width + 1);
+  const int y1 = std::min(frame.height, y + height + 1);
+  SkyMap map{x1 - x0, y1 - y0,
+             {.image_width = frame.width,
+              .image_height = frame.height,
+              .origin_x = x0,
+              .origin_y = y0}};
+  sampler_.sample(frame.camera, map);
+  compute_differentials(frame.camera, map);
+  auto rgba = shade(map, upper_sky_, lower_sky_, options_.filter);
+  supersample_edges(frame.camera, map, upper_sky_, lower_sky_,
+                    options_.samples_per_pixel, rgba);
+
+  RenderedTile tile{.x = x,
+                    .y = y,
+                    .width = width,
+                    .height = height,
+                    .rgba = std::vector<unsigned char>(
+                        static_cast<std::size_t>(width) * height * 4)};
+  for (int row = 0; row < height; ++row) {
+    const auto source =
+        (static_cast<std::size_t>(y - y0 + row) * map.width() + (x - x0)) * 4;
+    std::memcpy(tile.rgba.data() + static_cast<std::size_t>(row) * width * 4,
+                rgba.data() + source, static_cast<std::size_t>(width) * 4);
+  }
+  return tile;
+}
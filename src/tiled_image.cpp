@@ -0,0 +1,65 @@
+#include "tiled_image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "parallel.hpp"
+
+namespace {
+/* Interleave the bits of X and Y (x in the even bits). */
+auto morton_code(std::uint32_t x, std::uint32_t y) -> std::uint64_t {
+  const auto spread = [](std::uint64_t v) {
+    v &= 0xffffffff;
+    v = (v | (v << 16)) & 0x0000ffff0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0f;
+    v = (v | (v << 2)) & 0x3333333333333333;
+    v = (v | (v << 1)) & 0x5555555555555555;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+}  // namespace
+
+auto TiledImage::from_image(const Image& image, bool wrap_x) -> TiledImage {
+  TiledImage t{};
+  t.width = image.width;
+  t.height = image.height;
+  t.channels = image.channels;
+  t.tiles_x = (image.width + tile_size - 1) / tile_size;
+  t.tiles_y = (image.height + tile_size - 1) / tile_size;
+
+  /* Number the tiles in Z order. The grid is rarely a power of two square
+     (an equirectangular sky is 2:1), so sort by Morton code rather than
+     indexing by it, which keeps the storage dense. */
+  const std::size_t tile_count =
+      static_cast<std::size_t>(t.tiles_x) * t.tiles_y;
+  std::vector<std::uint32_t> order(tile_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+    return morton_code(a % t.tiles_x, a / t.tiles_x) <
+           morton_code(b % t.tiles_x, b / t.tiles_x);
+  });
+  t.slots.resize(tile_count);
+  for (std::size_t slot = 0; slot < tile_count; ++slot) {
+    t.slots[order[slot]] = static_cast<std::uint32_t>(slot);
+  }
+
+  t.data.resize(tile_count * t.tile_bytes());
+  parallel_for(tile_count, [&](auto tile) {
+    const int tx = static_cast<int>(tile % t.tiles_x);
+    const int ty = static_cast<int>(tile / t.tiles_x);
+    unsigned char* out = t.data.data() + t.slots[tile] * t.tile_bytes();
+    for (int ly = 0; ly < padded_size; ++ly) {
+      const int y = std::min(ty * tile_size + ly, image.height - 1);
+      for (int lx = 0; lx < padded_size; ++lx) {
+        int x = tx * tile_size + lx;
+        if (x >= image.width) x = wrap_x ? x % image.width : image.width - 1;
+        std::memcpy(out, image.texel(x, y), image.channels);
+        out += image.channels;
+      }
+    }
+  });
+  return t;
+}
@@ -0,0 +1,129 @@
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "wormhole.hpp"
+
+namespace {
+/* Past this |l| (in throat radii) space is flat enough that the rest of an
+   outgoing ray is treated as a straight line. */
+constexpr double escape_length = 40.0;
+/* Integration step as a fraction of the local circumferential radius r(l). */
+constexpr double step_scale = 0.03;
+/* Rays still bound after this many steps are orbiting the throat. */
+constexpr int max_steps = 20000;
+
+/* Rays are spherically symmetric geodesics, so each one stays on a great
+   circle. Instead of integrating (l, theta, phi, p_l, p_theta) we integrate
+   (l, p_l) and the angle psi travelled along that great circle; b is then
+   the ray's total angular momentum (B in the paper's notation). This sidesteps
+   the 1 / sin(theta) terms at the poles. */
+struct RayState {
+  double l;
+  double p_l;
+  double psi;
+};
+
+auto derivative(const RayState& s, double b) -> RayState {
+  const double r = wormhole_radius(s.l, parameters::p);
+  return {.l = s.p_l,
+          .p_l = b * b * wormhole_drdl(s.l, parameters::p) / (r * r * r),
+          .psi = b / (r * r)};
+}
+
+auto advance(const RayState& s, const RayState& d, double h) -> RayState {
+  return {s.l + h * d.l, s.p_l + h * d.p_l, s.psi + h * d.psi};
+}
+
+auto rk4_step(const RayState& s, double b, double h) -> RayState {
+  const auto k1 = derivative(s, b);
+  const auto k2 = derivative(advance(s, k1, h / 2), b);
+  const auto k3 = derivative(advance(s, k2, h / 2), b);
+  const auto k4 = derivative(advance(s, k3, h), b);
+  return {s.l + h / 6 * (k1.l + 2 * k2.l + 2 * k3.l + k4.l),
+          s.p_l + h / 6 * (k1.p_l + 2 * k2.p_l + 2 * k3.p_l + k4.p_l),
+          s.psi + h / 6 * (k1.psi + 2 * k2.psi + 2 * k3.psi + k4.psi)};
+}
+
+/* Any unit vector perpendicular to V. */
+auto perpendicular(Vec3 v) -> Vec3 {
+  const Vec3 axis =
+      std::abs(v.x) < 0.9 ? Vec3{1.0, 0.0, 0.0} : Vec3{0.0, 1.0, 0.0};
+  return normalize(cross(v, axis));
+}
+}  // namespace
+
+auto angular_position(const Camera& camera) -> Vec3 {
+  return {std::sin(camera.theta) * std::cos(camera.phi),
+          std::sin(camera.theta) * std::sin(camera.phi),
+          std::cos(camera.theta)};
+}
+
+RayGenerator::RayGenerator(const Camera& camera, int width, int height)
+    : camera_{camera}, width_{width}, height_{height} {
+  const Vec3 c = angular_position(camera);
+  const Vec3 north = {-std::cos(camera.theta) * std::cos(camera.phi),
+                      -std::cos(camera.theta) * std::sin(camera.phi),
+                      std::sin(camera.theta)};
+  /* Facing the throat means facing -e_l above it and +e_l below it. */
+  const Vec3 f0 = (camera.l >= 0.0 ? -1.0 : 1.0) * c;
+  const Vec3 r0 = cross(f0, north);
+
+  const Vec3 f1 = std::cos(camera.yaw) * f0 + std::sin(camera.yaw) * r0;
+  right_ = std::cos(camera.yaw) * r0 - std::sin(camera.yaw) * f0;
+  forward_ = std::cos(camera.pitch) * f1 + std::sin(camera.pitch) * north;
+  up_ = cross(right_, forward_);
+
+  scale_y_ = std::tan(camera.fov_y / 2.0);
+  scale_x_ = scale_y_ * width / height;
+}
+
+auto RayGenerator::direction(double x, double y) const -> Vec3 {
+  const double sx = (2.0 * x / width_ - 1.0) * scale_x_;
+  const double sy = (1.0 - 2.0 * y / height_) * scale_y_;
+  return normalize(forward_ + sx * right_ + sy * up_);
+}
+
+auto RayGenerator::image_position(Vec3 direction) const
+    -> std::optional<std::pair<double, double>> {
+  const double depth = dot(direction, forward_);
+  if (depth <= 0.0) return std::nullopt;
+  const double sx = dot(direction, right_) / (depth * scale_x_);
+  const double sy = dot(direction, up_) / (depth * scale_y_);
+  return std::pair{(sx + 1.0) * width_ / 2.0, (1.0 - sy) * height_ / 2.0};
+}
+
+auto trace(const Camera& camera, Vec3 direction) -> SkySample {
+  const Vec3 c = angular_position(camera);
+  const double n_l = dot(direction, c);
+  const Vec3 tangent = direction - n_l * c;
+  const double tangent_length = length(tangent);
+  const Vec3 u = tangent_length > 1e-12
+                     ? (1.0 / tangent_length) * tangent
+                     : perpendicular(c);
+
+  const double b =
+      wormhole_radius(camera.l, parameters::p) * tangent_length;
+  RayState s{.l = camera.l, .p_l = n_l, .psi = 0.0};
+
+  bool escaped = false;
+  for (int i = 0; i < max_steps; ++i) {
+    if (s.l * s.p_l > 0.0 && std::abs(s.l) > escape_length) {
+      escaped = true;
+      break;
+    }
+    const double r = wormhole_radius(s.l, parameters::p);
+    s = rk4_step(s, b, step_scale * r);
+  }
+
+  if (escaped) {
+    /* Remaining bend of a straight line with impact parameter b seen from
+       radius r. */
+    const double r = wormhole_radius(s.l, parameters::p);
+    s.psi += std::asin(std::min(1.0, b / r));
+  }
+
+  return {.direction = std::cos(s.psi) * c + std::sin(s.psi) * u,
+          .universe = s.l >= 0.0 ? Universe::Upper : Universe::Lower};
+}
@@ -0,0 +1,220 @@
+#include "virtual_texture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+constexpr char file_magic[4] = {'W', 'H', 'V', 'T'};
+constexpr std::uint32_t file_version = 1;
+/* Tiles start on multiples of this, so each can be faulted in and evicted
+   on its own. */
+constexpr std::size_t tile_alignment = 4096;
+
+struct FileHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t channels;
+  std::uint32_t tile_size;
+  std::uint32_t level_count;
+  std::uint32_t reserved;
+  std::uint64_t tile_stride;
+  std::uint64_t tile_count;
+  std::uint64_t data_offset;
+};
+
+struct FileLevel {
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t tiles_x;
+  std::uint32_t tiles_y;
+  std::uint64_t first_tile;
+};
+
+auto round_up(std::size_t n, std::size_t multiple) -> std::size_t {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+/* Print why FILE_PATH can't be opened. */
+auto fail(std::string_view file_path, std::string_view reason)
+    -> std::nullopt_t {
+  std::cerr << "[ERROR]: " << reason << " (" << file_path << ")\n";
+  return std::nullopt;
+}
+}  // namespace
+
+auto VirtualTexture::open(std::string_view file_path,
+                          std::size_t resident_budget)
+    -> std::optional<VirtualTexture> {
+  auto file = MappedFile::open(file_path);
+  if (!file || file->size() < sizeof(FileHeader)) {
+    return fail(file_path, "Virtual texture is missing or truncated");
+  }
+  /* Lookups jump around the sky; readahead would only pull in tiles nobody
+     asked for. */
+  file->advise_random();
+  const auto size = file->size();
+  const auto* bytes = file->data();
+
+  VirtualTexture t{};
+  t.resident_budget_ = resident_budget;
+  t.file_ = std::move(file);
+
+  FileHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+      header.version != file_version ||
+      header.tile_size != static_cast<std::uint32_t>(tile_size)) {
+    return fail(file_path, "Not a virtual texture this build can read");
+  }
+  const std::uint64_t tile_bytes =
+      static_cast<std::uint64_t>(padded_size) * padded_size * header.channels;
+  if (header.level_count == 0 || header.channels < 1 ||
+      header.channels > 4 || header.tile_stride < tile_bytes) {
+    return fail(file_path, "Virtual texture header is corrupt");
+  }
+  /* Divisions rather than products, which a corrupt header could make
+     wrap around. */
+  if (header.data_offset > size || header.data_offset < sizeof(FileHeader) ||
+      (header.data_offset - sizeof(FileHeader)) / sizeof(FileLevel) <
+          header.level_count ||
+      (size - header.data_offset) / header.tile_stride < header.tile_count) {
+    return fail(file_path, "Virtual texture is truncated");
+  }
+
+  t.channels_ = static_cast<int>(header.channels);
+  t.tile_stride_ = header.tile_stride;
+  t.tiles_ = bytes + header.data_offset;
+  const auto tiles_along = [](std::uint32_t size) {
+    return (static_cast<std::uint64_t>(size) + tile_size - 1) / tile_size;
+  };
+  for (std::uint32_t i = 0; i < header.level_count; ++i) {
+    FileLevel level;
+    std::memcpy(&level, bytes + sizeof(FileHeader) + i * sizeof(FileLevel),
+                sizeof(level));
+    const auto level_tiles =
+        static_cast<std::uint64_t>(level.tiles_x) * level.tiles_y;
+    if (level.width == 0 || level.height == 0 ||
+        level.width > std::numeric_limits<int>::max() ||
+        level.height > std::numeric_limits<int>::max() ||
+        level.tiles_x != tiles_along(level.width) ||
+        level.tiles_y != tiles_along(level.height) ||
+        level.first_tile > header.tile_count ||
+        level_tiles > header.tile_count - level.first_tile) {
+      return fail(file_path, "Virtual texture level table is corrupt");
+    }
+    t.levels_.push_back({.width = static_cast<int>(level.width),
+                         .height = static_cast<int>(level.height),
+                         .tiles_x = static_cast<int>(level.tiles_x),
+                         .tiles_y = static_cast<int>(level.tiles_y),
+                         .first_tile = level.first_tile});
+  }
+  t.last_used_ = std::vector<std::atomic<std::uint32_t>>(header.tile_count);
+  return t;
+}
+
+auto VirtualTexture::end_frame() -> void {
+  std::vector<std::size_t> resident;
+  for (std::size_t i = 0; i < last_used_.size(); ++i) {
+    if (last_used_[i].load(std::memory_order_relaxed) != 0) {
+      resident.push_back(i);
+    }
+  }
+
+  const std::size_t budget_tiles = resident_budget_ / tile_stride_;
+  if (resident.size() > budget_tiles) {
+    std::sort(resident.begin(), resident.end(), [&](auto a, auto b) {
+      return last_used_[a].load(std::memory_order_relaxed) <
+             last_used_[b].load(std::memory_order_relaxed);
+    });
+    /* With pages larger than tile_alignment a tile's edges stay behind
+       with its neighbours. */
+    const auto data_offset =
+        static_cast<std::size_t>(tiles_ - file_->data());
+    for (std::size_t i = 0; i < resident.size() - budget_tiles; ++i) {
+      auto& stamp = last_used_[resident[i]];
+      if (stamp.load(std::memory_order_relaxed) == frame_) break;
+      file_->release(data_offset + resident[i] * tile_stride_, tile_stride_);
+      stamp.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /* 0 marks evicted tiles, so skip it on wrap around. */
+  if (++frame_ == 0) frame_ = 1;
+}
+
+auto VirtualTexture::resident_tiles() const -> std::size_t {
+  return std::count_if(last_used_.begin(), last_used_.end(), [](auto& stamp) {
+    return stamp.load(std::memory_order_relaxed) != 0;
+  });
+}
+
+auto write_virtual_texture(std::string_view file_path,
+                           const std::vector<Image>& levels) -> bool {
+  std::ofstream out{std::string{file_path}, std::ios::binary};
+  if (!out) return false;
+
+  const int channels = levels.front().channels;
+  const std::size_t tile_bytes = static_cast<std::size_t>(
+                                     VirtualTexture::padded_size) *
+                                 VirtualTexture::padded_size * channels;
+  const std::size_t tile_stride = round_up(tile_bytes, tile_alignment);
+
+  std::vector<FileLevel> table;
+  std::uint64_t tile_count = 0;
+  for (const auto& level : levels) {
+    const auto tiles = [](int size) {
+      return static_cast<std::uint32_t>(
+          (size + VirtualTexture::tile_size - 1) / VirtualTexture::tile_size);
+    };
+    table.push_back({.width = static_cast<std::uint32_t>(level.width),
+                     .height = static_cast<std::uint32_t>(level.height),
+                     .tiles_x = tiles(level.width),
+                     .tiles_y = tiles(level.height),
+                     .first_tile = tile_count});
+    tile_count += static_cast<std::uint64_t>(table.back().tiles_x) *
+                  table.back().tiles_y;
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.channels = static_cast<std::uint32_t>(channels);
+  header.tile_size = VirtualTexture::tile_size;
+  header.level_count = static_cast<std::uint32_t>(levels.size());
+  header.tile_stride = tile_stride;
+  header.tile_count = tile_count;
+  header.data_offset = round_up(
+      sizeof(FileHeader) + table.size() * sizeof(FileLevel), tile_alignment);
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(table.data()),
+            static_cast<std::streamsize>(table.size() * sizeof(FileLevel)));
+  std::vector<char> tile(header.data_offset - sizeof(FileHeader) -
+                         table.size() * sizeof(FileLevel));
+  out.write(tile.data(), static_cast<std::streamsize>(tile.size()));
+
+  tile.assign(tile_stride, 0);
+  for (std::size_t i = 0; i < levels.size(); ++i) {
+    const auto& image = levels[i];
+    for (std::uint32_t ty = 0; ty < table[i].tiles_y; ++ty) {
+      for (std::uint32_t tx = 0; tx < table[i].tiles_x; ++tx) {
+        char* p = tile.data();
+        for (int ly = 0; ly < VirtualTexture::padded_size; ++ly) {
+          const int y = std::min<int>(ty * VirtualTexture::tile_size + ly,
+                                      image.height - 1);
+          for (int lx = 0; lx < VirtualTexture::padded_size; ++lx) {
+            const int x = static_cast<int>(
+                (tx * VirtualTexture::tile_size + lx) % image.width);
+            std::memcpy(p, image.texel(x, y), channels);
+            p += channels;
+          }
+        }
+        out.write(tile.data(), static_cast<std::streamsize>(tile_stride));
+      }
+    }
+  }
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,84 @@
+/* Converts a sky image into a BC1-compressed KTX2 file with its mip chain,
+   which Texture::from_file uploads as is: a sixth of the GPU memory of the
+   RGB original, and no decode or mipmap generation at load.
+
+   With --cube the image is taken as an equirectangular panorama and
+   stored as the six faces of a cube map, as TextureTarget::CubeMap would
+   build it.
+
+   Usage: sky_compress <image> <output.ktx2> [--cube] */
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "bc1.hpp"
+#include "cubemap.hpp"
+#include "ktx2.hpp"
+#include "mip_pyramid.hpp"
+
+auto main(int argc, char* argv[]) -> int {
+  if (argc < 3 || argc > 4 ||
+      (argc == 4 && std::strcmp(argv[3], "--cube") != 0)) {
+    std::cerr << "Usage: " << argv[0] << " <image> <output.ktx2> [--cube]\n";
+    return -1;
+  }
+  const bool cube = argc == 4;
+
+  int width, height, channels;
+  unsigned char* data = stbi_load(argv[1], &width, &height, &channels, 0);
+  if (!data) {
+    std::cerr << "[ERROR]: Failed to load image (" << argv[1] << ")\n";
+    return -1;
+  }
+  std::vector<Image> faces;
+  if (cube) {
+    const int face_size = std::max(1, width / 4);
+    for (auto& face :
+         equirect_to_cubemap(data, width, height, channels, face_size)) {
+      faces.push_back(std::move(face));
+    }
+  } else {
+    faces.push_back(
+        {.width = width,
+         .height = height,
+         .channels = channels,
+         .data = {data, data + static_cast<std::size_t>(width) * height *
+                                   channels}});
+  }
+  stbi_image_free(data);
+
+  /* Cube faces don't wrap; a panorama wraps across the dateline. */
+  std::vector<std::vector<Image>> pyramids;
+  for (auto& face : faces) {
+    pyramids.push_back(
+        build_mip_pyramid(std::move(face), MipFilter::Kaiser, !cube));
+  }
+
+  std::vector<Ktx2Image> levels;
+  for (std::size_t i = 0; i < pyramids.front().size(); ++i) {
+    Ktx2Image level{.width = pyramids.front()[i].width,
+                    .height = pyramids.front()[i].height,
+                    .data = {}};
+    for (const auto& pyramid : pyramids) {
+      const auto blocks = encode_bc1(pyramid[i]);
+      level.data.insert(level.data.end(), blocks.begin(), blocks.end());
+    }
+    levels.push_back(std::move(level));
+  }
+
+  /* Unorm, like the GL_RGB textures Texture uploads from images. */
+  if (!write_ktx2(argv[2], BlockFormat::Bc1Rgb,
+                  static_cast<int>(pyramids.size()), levels)) {
+    std::cerr << "[ERROR]: Failed to write compressed texture (" << argv[2]
+              << ")\n";
+    return -1;
+  }
+  std::cout << "Wrote " << levels.size() << " levels of "
+            << levels.front().width << "x" << levels.front().height
+            << (cube ? " cube map" : "") << " to " << argv[2] << "\n";
+  return 0;
+}
@@ -0,0 +1,48 @@
+/* Cuts a sky panorama into the mip-mapped tile file SkyTexture::from_virtual
+   pages in on demand. Runs offline, so unlike the renderer it may decode the
+   whole panorama at once.
+
+   Usage: sky_tiler <panorama> <output.vtex> [box|kaiser] */
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "mip_pyramid.hpp"
+#include "virtual_texture.hpp"
+
+auto main(int argc, char* argv[]) -> int {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <panorama> <output.vtex> [box|kaiser]\n";
+    return -1;
+  }
+  const auto filter = argc == 4 && std::strcmp(argv[3], "box") == 0
+                          ? MipFilter::Box
+                          : MipFilter::Kaiser;
+
+  int width, height, channels;
+  unsigned char* data = stbi_load(argv[1], &width, &height, &channels, 0);
+  if (!data) {
+    std::cerr << "[ERROR]: Failed to load panorama (" << argv[1] << ")\n";
+    return -1;
+  }
+  Image base{.width = width,
+             .height = height,
+             .channels = channels,
+             .data = {data, data + static_cast<std::size_t>(width) * height *
+                                       channels}};
+  stbi_image_free(data);
+
+  const auto levels = build_mip_pyramid(std::move(base), filter);
+  if (!write_virtual_texture(argv[2], levels)) {
+    std::cerr << "[ERROR]: Failed to write virtual texture (" << argv[2]
+              << ")\n";
+    return -1;
+  }
+  std::cout << "Wrote " << levels.size() << " levels of " << width << "x"
+            << height << " to " << argv[2] << "\n";
+  return 0;
+}